@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include <sinkline/OperatorDefinitions.h>
+#include <sinkline/Operators.h>
+
+#include "ThroughputBenchmark.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+using namespace fb::sinkline;
+using namespace fb::sinkline::operators;
+
+// Combines four large inputs with the given operator, which should pass them
+// along as const references.
+template<template<typename...> class Operator>
+static void runLargeValueBenchmark (const char *name, std::atomic<uint64_t> &checksum)
+{
+  using Values = std::vector<int>;
+
+  runThroughputBenchmark(name, [&](unsigned threadCount, uint64_t iterations) {
+    Operator<void, Values, Values, Values, Values> sink([&](const Values &a, const Values &b, const Values &c, const Values &d) {
+      checksum.fetch_add(uint64_t(a.front() + b.front() + c.front() + d.front()), std::memory_order_relaxed);
+    });
+
+    auto sinks = sink.sinks();
+    std::vector<std::function<bool(Values)>> inputs = {
+      std::get<0>(sinks), std::get<1>(sinks), std::get<2>(sinks), std::get<3>(sinks),
+    };
+
+    for (auto &input : inputs) {
+      input(Values(1024));
+    }
+
+    return [inputs](unsigned thread, uint64_t iteration) {
+      inputs[thread % inputs.size()](Values(1024, int(iteration)));
+    };
+  }, 20000);
+}
+
+// Each producer thread writes to one of eight inputs (wrapping around when
+// there are more threads than inputs). Every input is given a value up front,
+// so each write emits a combined snapshot.
+int main ()
+{
+  std::atomic<uint64_t> checksum(0);
+
+  runThroughputBenchmark("CombineOperator", [&](unsigned threadCount, uint64_t iterations) {
+    CombineOperator<void, int, int, int, int, int, int, int, int> sink([&](int a, int b, int c, int d, int e, int f, int g, int h) {
+      checksum.fetch_add(uint64_t(a + b + c + d + e + f + g + h), std::memory_order_relaxed);
+    });
+
+    auto sinks = sink.sinks();
+    std::vector<std::function<bool(int)>> inputs = {
+      std::get<0>(sinks), std::get<1>(sinks), std::get<2>(sinks), std::get<3>(sinks),
+      std::get<4>(sinks), std::get<5>(sinks), std::get<6>(sinks), std::get<7>(sinks),
+    };
+
+    for (auto &input : inputs) {
+      input(0);
+    }
+
+    return [inputs](unsigned thread, uint64_t iteration) {
+      inputs[thread % inputs.size()](int(iteration));
+    };
+  });
+
+  runThroughputBenchmark("combine()", [&](unsigned threadCount, uint64_t iterations) {
+    auto sinks = combine<int, int, int, int, int, int, int, int>([&](int a, int b, int c, int d, int e, int f, int g, int h) {
+      checksum.fetch_add(uint64_t(a + b + c + d + e + f + g + h), std::memory_order_relaxed);
+    });
+
+    std::vector<std::function<bool(int)>> inputs = {
+      std::get<0>(sinks), std::get<1>(sinks), std::get<2>(sinks), std::get<3>(sinks),
+      std::get<4>(sinks), std::get<5>(sinks), std::get<6>(sinks), std::get<7>(sinks),
+    };
+
+    for (auto &input : inputs) {
+      input(0);
+    }
+
+    return [inputs](unsigned thread, uint64_t iteration) {
+      inputs[thread % inputs.size()](int(iteration));
+    };
+  });
+
+  runLargeValueBenchmark<CombineOperator>("CombineOperator (large values)", checksum);
+  runLargeValueBenchmark<SharedCombineOperator>("SharedCombineOperator (large values)", checksum);
+
+  return 0;
+}
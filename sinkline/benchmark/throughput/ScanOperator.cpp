@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include <sinkline/Operators.h>
+
+#include "ThroughputBenchmark.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+using namespace fb::sinkline;
+using namespace fb::sinkline::operators;
+
+static uint64_t add (uint64_t sum, uint64_t value)
+{
+  return sum + value;
+}
+
+// Every producer thread counts into the same scan, which forwards each new
+// sum to a sink that just keeps the latest one.
+template<typename Operator>
+static void runCounterBenchmark (const char *name, const Operator &op)
+{
+  std::atomic<uint64_t> latest(0);
+
+  runThroughputBenchmark(name, [&](unsigned threadCount, uint64_t iterations) {
+    auto sink = op.compose([&latest](uint64_t sum) {
+      latest.store(sum, std::memory_order_relaxed);
+    });
+
+    return [sink](unsigned thread, uint64_t iteration) {
+      sink(uint64_t(1));
+    };
+  });
+}
+
+int main ()
+{
+  runCounterBenchmark("scan (std::mutex)", scan(uint64_t(0), &add));
+  runCounterBenchmark("atomicScan", atomicScan(uint64_t(0), &add));
+  runCounterBenchmark("shardedScan", shardedScan(uint64_t(0), &add));
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_THROUGHPUT_BENCHMARK_H
+#define FB_SINKLINE_THROUGHPUT_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+/// Measures how many operations per second a workload sustains as the number
+/// of producer threads doubles from 1 to `maxThreads`, printing one line per
+/// thread count.
+///
+/// `setUp` is invoked once per thread count with the thread count and the
+/// number of iterations each thread will run, and should return the
+/// operation: a callable taking the thread index and iteration number.
+template<typename SetUp>
+void runThroughputBenchmark (const char *name, SetUp setUp, uint64_t iterations = 200000, unsigned maxThreads = 64)
+{
+  for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+    auto operation = setUp(threadCount, iterations);
+
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned thread = 0; thread < threadCount; thread++) {
+      threads.emplace_back([&operation, thread, iterations] {
+        for (uint64_t iteration = 0; iteration < iterations; iteration++) {
+          operation(thread, iteration);
+        }
+      });
+    }
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double total = double(threadCount) * double(iterations);
+
+    std::printf("%s\t%u threads\t%.0f ops/s\n", name, threadCount, total / elapsed.count());
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_ARRAY_VIEW_H
+#define FB_SINKLINE_ARRAY_VIEW_H
+
+#include <cstddef>
+
+namespace fb { namespace sinkline {
+
+/// A non-owning, read-only view of contiguous values, like a C++20 std::span
+/// of const elements.
+///
+/// The view is only valid as long as the storage it refers to.
+template<typename T>
+class ArrayView final
+{
+  public:
+    using value_type = T;
+    using const_iterator = const T *;
+
+    constexpr ArrayView () noexcept
+      : _data(nullptr)
+      , _size(0)
+    {}
+
+    constexpr ArrayView (const T *data, size_t size) noexcept
+      : _data(data)
+      , _size(size)
+    {}
+
+    constexpr const T *data () const noexcept
+    {
+      return _data;
+    }
+
+    constexpr size_t size () const noexcept
+    {
+      return _size;
+    }
+
+    constexpr bool empty () const noexcept
+    {
+      return _size == 0;
+    }
+
+    /// The value at the given index, which must be less than size().
+    constexpr const T &operator[] (size_t index) const noexcept
+    {
+      return _data[index];
+    }
+
+    constexpr const_iterator begin () const noexcept
+    {
+      return _data;
+    }
+
+    constexpr const_iterator end () const noexcept
+    {
+      return _data + _size;
+    }
+
+  private:
+    const T *_data;
+    size_t _size;
+};
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_COROUTINES_H
+#define FB_SINKLINE_COROUTINES_H
+
+#include "PlatformSupport.h"
+
+#if __cplusplus > 201703L && __has_include(<coroutine>)
+#include <coroutine>
+#endif
+
+#ifdef __cpp_lib_coroutine
+
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "BlockConvertible.h"
+
+namespace fb { namespace sinkline {
+
+/// Awaits a scheduler, by resuming the awaiting coroutine upon it.
+///
+/// If the scheduler drops the resumption instead (e.g. because it is bounded
+/// and full, or is destroyed first), the awaiting coroutine is destroyed
+/// rather than leaked, along with any Asyncs awaiting it. If post() throws,
+/// the exception is rethrown from the `co_await` instead.
+template<typename Scheduler>
+class ScheduleAwaiter final
+{
+  public:
+    ScheduleAwaiter () = delete;
+
+    explicit ScheduleAwaiter (Scheduler &scheduler) noexcept
+      : _scheduler(scheduler)
+    {}
+
+    bool await_ready () const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend (std::coroutine_handle<> handle)
+    {
+      // The coroutine may be resumed (or destroyed) on another thread as soon
+      // as it has been posted, so nothing in it may be touched afterward,
+      // including this awaiter.
+      Scheduler &scheduler = _scheduler;
+
+      Posting &posting = currentPosting();
+      Posting previous = posting;
+      posting = Posting{handle.address(), false};
+
+      try {
+        // The handle fits inline in a Task, so this doesn't allocate anything
+        // beyond the scheduler's queue node.
+        scheduler.post(Resume(handle));
+      } catch (...) {
+        posting = previous;
+        throw;
+      }
+
+      bool dropped = posting._dropped;
+      posting = previous;
+
+      if (dropped) {
+        handle.destroy();
+      }
+    }
+
+    void await_resume () const noexcept
+    {}
+
+  private:
+    // The coroutine being posted from the current thread, if any. If its
+    // resumption is dropped synchronously, the coroutine can't be destroyed
+    // yet, because post() might still throw back into it.
+    struct Posting final
+    {
+      void *_address;
+      bool _dropped;
+    };
+
+    static Posting &currentPosting () noexcept
+    {
+      static thread_local Posting posting{nullptr, false};
+      return posting;
+    }
+
+    // Resumes the coroutine when run, or destroys it if never run.
+    struct Resume final
+    {
+      public:
+        explicit Resume (std::coroutine_handle<> handle) noexcept
+          : _handle(handle)
+        {}
+
+        Resume (Resume &&other) noexcept
+          : _handle(std::exchange(other._handle, nullptr))
+        {}
+
+        Resume &operator= (Resume &&) = delete;
+
+        ~Resume ()
+        {
+          if (!_handle) {
+            return;
+          }
+
+          Posting &posting = currentPosting();
+          if (posting._address == _handle.address()) {
+            posting._dropped = true;
+          } else {
+            _handle.destroy();
+          }
+        }
+
+        void operator() ()
+        {
+          std::exchange(_handle, nullptr).resume();
+        }
+
+      private:
+        std::coroutine_handle<> _handle;
+    };
+
+    Scheduler &_scheduler;
+};
+
+/// Allows `co_await scheduler` to hop onto any scheduler which supports
+/// post(), like ThreadScheduler or ThreadPoolScheduler. The coroutine
+/// continues upon the scheduler once the expression completes.
+///
+/// To await a std::shared_ptr to a scheduler, dereference it first.
+template<typename Scheduler>
+requires requires (Scheduler &scheduler, void (*action)()) {
+  scheduler.post(action);
+}
+ScheduleAwaiter<Scheduler> operator co_await (Scheduler &scheduler) noexcept
+{
+  return ScheduleAwaiter<Scheduler>(scheduler);
+}
+
+/// A coroutine which starts immediately, and whose result nobody awaits.
+///
+/// Like actions given to post(), any exception thrown from the coroutine is
+/// discarded.
+struct DetachedCoroutine final
+{
+  public:
+    struct promise_type final
+    {
+      DetachedCoroutine get_return_object () const noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never initial_suspend () const noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never final_suspend () const noexcept
+      {
+        return {};
+      }
+
+      void return_void () const noexcept
+      {}
+
+      void unhandled_exception () const noexcept
+      {}
+    };
+};
+
+template<typename T>
+class Async;
+
+/// Stores the result (or exception) of an Async coroutine.
+template<typename T>
+struct AsyncResult
+{
+  public:
+    void return_value (T value)
+    {
+      _value.emplace(std::move(value));
+    }
+
+    T takeResult ()
+    {
+      if (_exception) {
+        std::rethrow_exception(_exception);
+      }
+
+      return std::move(*_value);
+    }
+
+    std::exception_ptr _exception;
+    std::optional<T> _value;
+};
+
+template<>
+struct AsyncResult<void>
+{
+  public:
+    void return_void () noexcept
+    {}
+
+    void takeResult ()
+    {
+      if (_exception) {
+        std::rethrow_exception(_exception);
+      }
+    }
+
+    std::exception_ptr _exception;
+};
+
+/// A lazily-started coroutine which produces a `T` (or throws).
+///
+/// An Async only starts once it is awaited, and the awaiting coroutine is
+/// resumed directly (on whichever thread the Async finished upon) when it
+/// completes. No std::future or other shared state is involved.
+template<typename T = void>
+class Async final
+{
+  public:
+    struct promise_type final : public AsyncResult<T>
+    {
+      std::coroutine_handle<> _continuation;
+      Async *_owner = nullptr;
+
+      promise_type () = default;
+
+      promise_type (const promise_type &) = delete;
+      promise_type &operator= (const promise_type &) = delete;
+
+      ~promise_type ()
+      {
+        // If the Async still owns this frame, it is being destroyed from
+        // elsewhere, because a scheduler dropped its resumption. The awaiting
+        // coroutine can never be resumed either, so destroy it too.
+        if (_owner) {
+          _owner->_handle = nullptr;
+
+          if (_continuation) {
+            _continuation.destroy();
+          }
+        }
+      }
+
+      Async get_return_object () noexcept
+      {
+        return Async(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend () const noexcept
+      {
+        return {};
+      }
+
+      struct FinalAwaiter final
+      {
+        bool await_ready () const noexcept
+        {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend (std::coroutine_handle<promise_type> handle) const noexcept
+        {
+          if (auto continuation = handle.promise()._continuation) {
+            return continuation;
+          } else {
+            return std::noop_coroutine();
+          }
+        }
+
+        void await_resume () const noexcept
+        {}
+      };
+
+      FinalAwaiter final_suspend () const noexcept
+      {
+        return {};
+      }
+
+      void unhandled_exception () noexcept
+      {
+        this->_exception = std::current_exception();
+      }
+    };
+
+    Async (const Async &) = delete;
+    Async &operator= (const Async &) = delete;
+
+    Async (Async &&other) noexcept
+      : _handle(std::exchange(other._handle, nullptr))
+    {
+      adopt();
+    }
+
+    Async &operator= (Async &&other) noexcept
+    {
+      if (&other != this) {
+        reset();
+
+        _handle = std::exchange(other._handle, nullptr);
+        adopt();
+      }
+
+      return *this;
+    }
+
+    ~Async ()
+    {
+      reset();
+    }
+
+    bool await_ready () const noexcept
+    {
+      return false;
+    }
+
+    std::coroutine_handle<> await_suspend (std::coroutine_handle<> continuation) noexcept
+    {
+      _handle.promise()._continuation = continuation;
+      return _handle;
+    }
+
+    T await_resume ()
+    {
+      return _handle.promise().takeResult();
+    }
+
+  private:
+    explicit Async (std::coroutine_handle<promise_type> handle) noexcept
+      : _handle(handle)
+    {
+      adopt();
+    }
+
+    void adopt () noexcept
+    {
+      if (_handle) {
+        _handle.promise()._owner = this;
+      }
+    }
+
+    void reset () noexcept
+    {
+      if (_handle) {
+        _handle.promise()._owner = nullptr;
+        std::exchange(_handle, nullptr).destroy();
+      }
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+/// Implements thenCoroutine().
+template<typename Action>
+struct CoroutineThenOperator final
+{
+  public:
+    CoroutineThenOperator () = delete;
+
+    explicit CoroutineThenOperator (const Action &action) noexcept(std::is_nothrow_copy_constructible<Action>::value)
+      : _action(action)
+    {}
+
+    explicit CoroutineThenOperator (Action &&action) noexcept(std::is_nothrow_move_constructible<Action>::value)
+      : _action(std::move(action))
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      return makeBlockConvertible([newNext = std::move(newNext), action = _action](auto &&...inputs) {
+        forward(action(std::forward<decltype(inputs)>(inputs)...), newNext);
+      });
+    }
+
+  private:
+    Action _action;
+
+    template<typename T, typename Next>
+    static DetachedCoroutine forward (Async<T> async, Next next)
+    {
+      if constexpr (std::is_void<T>::value) {
+        co_await async;
+        next();
+      } else {
+        next(co_await async);
+      }
+    }
+};
+
+/// Invokes the given coroutine for each input value, and forwards its result
+/// once it completes.
+///
+/// The action must return an Async, and can `co_await` other Asyncs or
+/// schedulers along the way. Unlike then(), no callback needs to be threaded
+/// through the action. The result of further processing is discarded, as are
+/// any exceptions thrown from the action.
+///
+/// Since the coroutine may outlive the call that started it, it should take
+/// its inputs by value.
+template<typename Callable>
+auto thenCoroutine (Callable &&action)
+{
+  return CoroutineThenOperator<std::remove_reference_t<Callable>>(std::forward<Callable>(action));
+}
+
+} } // namespace fb::sinkline
+
+#endif // __cpp_lib_coroutine
+
+#endif
@@ -0,0 +1,303 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "EventLoopScheduler.h"
+
+#ifdef EPOLLIN
+
+#include <cerrno>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace fb::sinkline;
+
+namespace {
+
+// The most readiness events to collect from a single epoll_wait().
+constexpr int maxEvents = 64;
+
+// The state of the EventLoopScheduler whose thread is the current thread, if
+// any.
+thread_local const void *currentEventLoop = nullptr;
+
+void throwSystemError (const char *what)
+{
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+}
+
+EventLoopScheduler::EventLoopScheduler ()
+  : _state(std::make_shared<State>())
+{
+  std::thread([state = _state] {
+    detachedThreadMain(state);
+  }).detach();
+}
+
+bool EventLoopScheduler::isCurrent () const noexcept
+{
+  return currentEventLoop == _state.get();
+}
+
+void EventLoopScheduler::watch (int fd, uint32_t events, readiness_sink_type sink)
+{
+  std::lock_guard<std::mutex> guard(_state->_watchMutex);
+
+  if (_state->_watches.count(fd) > 0) {
+    throw std::system_error(EEXIST, std::system_category(), "file descriptor is already being watched");
+  }
+
+  auto watch = std::make_unique<Watch>(fd, std::move(sink));
+
+  epoll_event event{};
+  event.events = events;
+  event.data.ptr = watch.get();
+
+  if (epoll_ctl(_state->_epollFD, EPOLL_CTL_ADD, fd, &event) != 0) {
+    throwSystemError("epoll_ctl");
+  }
+
+  _state->_watches.emplace(fd, watch.release());
+}
+
+void EventLoopScheduler::unwatch (int fd)
+{
+  Watch *watch;
+
+  {
+    std::lock_guard<std::mutex> guard(_state->_watchMutex);
+
+    auto it = _state->_watches.find(fd);
+    if (it == _state->_watches.end()) {
+      return;
+    }
+
+    watch = it->second;
+    _state->_watches.erase(it);
+
+    watch->_active = false;
+    epoll_ctl(_state->_epollFD, EPOLL_CTL_DEL, fd, nullptr);
+  }
+
+  // The event loop thread may already have received an event for this watch,
+  // so it can only be freed from that thread, after it has finished
+  // dispatching the current batch of events.
+  _state->enqueue([watch = std::unique_ptr<Watch>(watch)] {});
+}
+
+void EventLoopScheduler::shutdown ()
+{
+  _state->_running = false;
+  _state->wakeUp();
+}
+
+EventLoopScheduler::State::State ()
+  : _epollFD(-1)
+  , _wakeupFD(-1)
+  , _timerFD(-1)
+  , _sleeping(false)
+  , _wakeupPending(false)
+  , _running(true)
+{
+  try {
+    if ((_epollFD = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      throwSystemError("epoll_create1");
+    }
+
+    if ((_wakeupFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      throwSystemError("eventfd");
+    }
+
+    if ((_timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+      throwSystemError("timerfd_create");
+    }
+
+    // The internal file descriptors are identified by the addresses of
+    // their fields, which can never collide with a Watch.
+    for (int *fd : {&_wakeupFD, &_timerFD}) {
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.ptr = fd;
+
+      if (epoll_ctl(_epollFD, EPOLL_CTL_ADD, *fd, &event) != 0) {
+        throwSystemError("epoll_ctl");
+      }
+    }
+  } catch (...) {
+    closeFileDescriptors();
+    throw;
+  }
+}
+
+EventLoopScheduler::State::~State ()
+{
+  for (auto &entry : _watches) {
+    delete entry.second;
+  }
+
+  closeFileDescriptors();
+}
+
+void EventLoopScheduler::State::closeFileDescriptors () noexcept
+{
+  for (int fd : {_timerFD, _wakeupFD, _epollFD}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void EventLoopScheduler::State::enqueue (Task action)
+{
+  _queue.push(std::move(action));
+
+  // The event loop thread sets _sleeping before it checks the queue for the
+  // last time, so if it's not set yet, the new action will be seen without
+  // waking up.
+  if (_sleeping) {
+    wakeUp();
+  }
+}
+
+void EventLoopScheduler::State::enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action)
+{
+  std::lock_guard<std::mutex> guard(_timerMutex);
+
+  if (_timers.push(deadline, std::move(action))) {
+    armTimer();
+  }
+}
+
+void EventLoopScheduler::State::wakeUp () noexcept
+{
+  if (!_wakeupPending.exchange(true)) {
+    uint64_t value = 1;
+    ssize_t written = write(_wakeupFD, &value, sizeof(value));
+    (void)written;
+  }
+}
+
+void EventLoopScheduler::State::armTimer () noexcept
+{
+  itimerspec spec{};
+
+  if (!_timers.empty()) {
+    auto sinceEpoch = _timers.nextDeadline().time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - seconds);
+
+    spec.it_value.tv_sec = seconds.count();
+    spec.it_value.tv_nsec = nanoseconds.count();
+
+    // A zero it_value would disarm the timer instead.
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      spec.it_value.tv_nsec = 1;
+    }
+  }
+
+  // steady_clock is CLOCK_MONOTONIC, so its deadlines can be used as-is.
+  timerfd_settime(_timerFD, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventLoopScheduler::runActions (State &state)
+{
+  state._batch = state._queue.popAll();
+
+  while (!state._batch.empty()) {
+    state._batch.runFront();
+  }
+}
+
+void EventLoopScheduler::runExpiredTimers (State &state)
+{
+  uint64_t expirations;
+  ssize_t result = read(state._timerFD, &expirations, sizeof(expirations));
+  (void)result;
+
+  std::vector<Task> expired;
+
+  {
+    std::lock_guard<std::mutex> guard(state._timerMutex);
+
+    state._timers.popExpired(std::chrono::steady_clock::now(), expired);
+    state.armTimer();
+  }
+
+  for (auto &action : expired) {
+    action();
+  }
+}
+
+void EventLoopScheduler::detachedThreadMain (std::shared_ptr<State> state)
+{
+  currentEventLoop = state.get();
+
+  epoll_event events[maxEvents];
+
+  while (state->_running) {
+    runActions(*state);
+
+    // This must be visible before the queue is checked below, so that any
+    // producer which pushes after the check will see that it needs to wake
+    // us up.
+    state->_sleeping = true;
+
+    int timeout = state->_queue.empty() ? -1 : 0;
+    int count = epoll_wait(state->_epollFD, events, maxEvents, timeout);
+
+    state->_sleeping = false;
+
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      // Nothing on this thread could catch an exception, so just stop the
+      // loop, as if it had been shut down.
+      state->_running = false;
+      break;
+    }
+
+    for (int i = 0; i < count; i++) {
+      void *ptr = events[i].data.ptr;
+
+      if (ptr == &state->_wakeupFD) {
+        uint64_t value;
+        ssize_t result = read(state->_wakeupFD, &value, sizeof(value));
+        (void)result;
+
+        // Any producer which sees this cleared will signal again, and any
+        // which saw it set pushed its action before we drain the queue.
+        state->_wakeupPending = false;
+      } else if (ptr == &state->_timerFD) {
+        runExpiredTimers(*state);
+      } else {
+        auto watch = static_cast<Watch *>(ptr);
+
+        if (watch->_active) {
+          // epoll_event may be packed, so its field can't be forwarded as a
+          // reference.
+          uint32_t ready = events[i].events;
+
+          // Like posted actions, any exception thrown by the sink is
+          // discarded instead of terminating the event loop.
+          runDiscardedAction(watch->_sink, watch->_fd, ready);
+        }
+      }
+    }
+  }
+}
+
+#endif // EPOLLIN
@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_EVENT_LOOP_SCHEDULER_H
+#define FB_SINKLINE_EVENT_LOOP_SCHEDULER_H
+
+#include "PlatformSupport.h"
+
+#if __has_include(<sys/epoll.h>)
+#include <sys/epoll.h>
+#endif
+
+#ifdef EPOLLIN
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "Scheduler.h"
+#include "Task.h"
+#include "TaskQueue.h"
+#include "TimerQueue.h"
+
+namespace fb { namespace sinkline {
+
+/// Runs actions upon a detached thread which waits using epoll.
+///
+/// Besides the usual schedule() methods, the same thread can watch file
+/// descriptors (sockets, pipes, eventfds, timerfds, etc.) and deliver their
+/// readiness to a sink, without an extra hop through another scheduler.
+///
+/// Actions are run in the order they were scheduled. Timers and file
+/// descriptor events are interleaved with them as they become ready.
+class EventLoopScheduler final
+{
+  public:
+    /// The type of sink which receives readiness events, as the file
+    /// descriptor and the epoll event flags that were reported for it.
+    using readiness_sink_type = std::function<void(int, uint32_t)>;
+
+    /// Throws std::system_error if the epoll instance (or its supporting file
+    /// descriptors) cannot be created.
+    EventLoopScheduler ();
+
+    EventLoopScheduler (const EventLoopScheduler &) = delete;
+    EventLoopScheduler &operator= (const EventLoopScheduler &) = delete;
+
+    EventLoopScheduler (EventLoopScheduler &&) = default;
+    EventLoopScheduler &operator= (EventLoopScheduler &&) = default;
+
+    ~EventLoopScheduler ()
+    {
+      if (_state) {
+        shutdown();
+      }
+    }
+
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      _state->enqueue([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// Like schedule(), but discards the result of the action instead of
+    /// creating a std::future for it.
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      _state->enqueue([call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
+
+    /// Like post(), but runs the action immediately if this is called from
+    /// the event loop thread, and no other actions are waiting to run ahead of
+    /// it.
+    template<typename F, typename ...Args>
+    void dispatch (F &&action, Args &&...args)
+    {
+      if (isCurrent() && _state->_batch.empty() && _state->_queue.empty()) {
+        runDiscardedAction(std::forward<F>(action), std::forward<Args>(args)...);
+      } else {
+        post(std::forward<F>(action), std::forward<Args>(args)...);
+      }
+    }
+
+    /// Whether the calling thread is this scheduler's event loop thread.
+    bool isCurrent () const noexcept;
+
+    /// Like schedule(), but waits until the given time before running the
+    /// action.
+    ///
+    /// Timers share a single timerfd, which is always armed for the earliest
+    /// deadline.
+    template<typename Clock, typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      _state->enqueueAfter(toSteadyTimePoint(timePoint), [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// Starts watching the given file descriptor for the given epoll events
+    /// (e.g., EPOLLIN or EPOLLOUT), invoking the sink upon the event loop
+    /// thread each time it becomes ready.
+    ///
+    /// The file descriptor is watched in level-triggered mode unless EPOLLET
+    /// is included in `events`. Each descriptor can only be watched once at a
+    /// time. Like posted actions, any exception thrown by the sink is
+    /// discarded.
+    ///
+    /// Throws std::system_error if the file descriptor cannot be watched.
+    void watch (int fd, uint32_t events, readiness_sink_type sink);
+
+    /// Stops watching the given file descriptor. Once this returns, its sink
+    /// will not be invoked again (though an invocation may still be in
+    /// progress on the event loop thread). The file descriptor is not closed.
+    void unwatch (int fd);
+
+    void shutdown ();
+
+  private:
+    struct Watch final {
+      int _fd;
+      readiness_sink_type _sink;
+      std::atomic<bool> _active;
+
+      Watch (int fd, readiness_sink_type sink)
+        : _fd(fd)
+        , _sink(std::move(sink))
+        , _active(true)
+      {}
+    };
+
+    struct State {
+      int _epollFD;
+      int _wakeupFD;
+      int _timerFD;
+
+      // Producers push onto this without locking, and only the event loop
+      // thread pops from it.
+      TaskQueue _queue;
+
+      // Actions which have been taken from _queue, and are being run. Only
+      // accessed by the event loop thread.
+      TaskList _batch;
+
+      // Set by the event loop thread just before it waits in epoll_wait(), so
+      // that producers only need to signal _wakeupFD when it might be
+      // waiting.
+      std::atomic<bool> _sleeping;
+
+      // Set when _wakeupFD has been signaled, but not yet read, so that
+      // multiple producers don't each write to it.
+      std::atomic<bool> _wakeupPending;
+
+      std::atomic<bool> _running;
+
+      // Must be synchronized on _timerMutex.
+      std::mutex _timerMutex;
+      TimerQueue<> _timers;
+
+      // Watches by file descriptor. Must be synchronized on _watchMutex.
+      std::mutex _watchMutex;
+      std::unordered_map<int, Watch *> _watches;
+
+      State ();
+      ~State ();
+
+      void closeFileDescriptors () noexcept;
+
+      void enqueue (Task action);
+      void enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action);
+
+      void wakeUp () noexcept;
+
+      // Must be called while holding _timerMutex.
+      void armTimer () noexcept;
+    };
+
+    std::shared_ptr<State> _state;
+
+    static void runActions (State &state);
+    static void runExpiredTimers (State &state);
+    static void detachedThreadMain (std::shared_ptr<State> state);
+};
+
+} } // namespace fb::sinkline
+
+#endif // EPOLLIN
+
+#endif
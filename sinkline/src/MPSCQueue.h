@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_MPSC_QUEUE_H
+#define FB_SINKLINE_MPSC_QUEUE_H
+
+#include <atomic>
+
+namespace fb { namespace sinkline {
+
+/// The link that a type must inherit from to be stored in an MPSCQueue.
+template<typename Node>
+struct MPSCQueueHook
+{
+  public:
+    Node *_queueNext = nullptr;
+};
+
+/// An intrusive, lock-free queue which supports any number of concurrent
+/// producers, and one consumer.
+///
+/// The consumer can only remove every node at once, which is meant to match
+/// the "swap out the whole queue, then run it" style of draining that the
+/// schedulers use. The queue never allocates or frees nodes itself.
+template<typename Node>
+class MPSCQueue final
+{
+  public:
+    constexpr MPSCQueue () noexcept
+      : _head(nullptr)
+    {}
+
+    MPSCQueue (const MPSCQueue &) = delete;
+    MPSCQueue &operator= (const MPSCQueue &) = delete;
+
+    /// Adds a node to the back of the queue. This is safe to call from any
+    /// thread.
+    ///
+    /// Returns whether the queue was empty beforehand.
+    bool push (Node *node) noexcept
+    {
+      Node *head = _head.load(std::memory_order_relaxed);
+
+      do {
+        node->_queueNext = head;
+      } while (!_head.compare_exchange_weak(head, node));
+
+      return head == nullptr;
+    }
+
+    /// Removes every node from the queue, returning a list (linked through
+    /// _queueNext) with the oldest node first.
+    ///
+    /// This is only meant to be called from the consumer. However, since the
+    /// nodes are detached atomically, it is still safe for multiple threads
+    /// to call this concurrently (they will each receive disjoint lists).
+    ///
+    /// If `tail` is not NULL, it is set to the last (newest) node returned.
+    Node *popAll (Node **tail = nullptr) noexcept
+    {
+      Node *node = _head.exchange(nullptr);
+
+      if (tail) {
+        *tail = node;
+      }
+
+      // Nodes were pushed onto the front, so reverse them back into FIFO
+      // order.
+      Node *reversed = nullptr;
+      while (node) {
+        Node *next = node->_queueNext;
+        node->_queueNext = reversed;
+        reversed = node;
+        node = next;
+      }
+
+      return reversed;
+    }
+
+    bool empty () const noexcept
+    {
+      return _head.load() == nullptr;
+    }
+
+  private:
+    std::atomic<Node *> _head;
+};
+
+} } // namespace fb::sinkline
+
+#endif
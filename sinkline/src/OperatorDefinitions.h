@@ -10,17 +10,27 @@
 #ifndef FB_SINKLINE_OPERATOR_DEFINITIONS_H
 #define FB_SINKLINE_OPERATOR_DEFINITIONS_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <forward_list>
 #include <functional>
+#include <initializer_list>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "ArrayView.h"
 #include "BlockConvertible.h"
 #include "CallableType.h"
 #include "Optional.h"
 #include "PlatformSupport.h"
+#include "SchedulingPriority.h"
+#include "Task.h"
 #include "TupleExt.h"
 
 namespace fb { namespace sinkline {
@@ -162,6 +172,203 @@ struct ScanOperator<void, Accumulator, Transform> final
     Transform _transform;
 };
 
+/// A mutex which doesn't lock anything, for operators which accept `void` as
+/// their Mutex type.
+struct NullMutex final
+{
+  public:
+    void lock () noexcept
+    {}
+
+    void unlock () noexcept
+    {}
+};
+
+/// The given Mutex type, or NullMutex if it is `void`.
+template<typename Mutex>
+using MutexOrNull = std::conditional_t<std::is_void<Mutex>::value, NullMutex, Mutex>;
+
+/// Implements scanInPlace().
+template<typename Mutex, typename Accumulator, typename Transform>
+struct InPlaceScanOperator final
+{
+  public:
+    InPlaceScanOperator () = delete;
+
+    explicit InPlaceScanOperator (Accumulator initialValue, const Transform &transform) noexcept(std::is_nothrow_move_constructible<Accumulator>::value && std::is_nothrow_copy_constructible<Transform>::value)
+      : _initial(std::move(initialValue))
+      , _transform(transform)
+    {}
+
+    explicit InPlaceScanOperator (Accumulator initialValue, Transform &&transform) noexcept(std::is_nothrow_move_constructible<Accumulator>::value && std::is_nothrow_move_constructible<Transform>::value)
+      : _initial(std::move(initialValue))
+      , _transform(std::move(transform))
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      return makeBlockConvertible([newNext = std::move(newNext), transform = _transform, accum = std::make_shared<Accumulator>(_initial), mutex = std::make_shared<MutexOrNull<Mutex>>()](auto &&...inputs) {
+        // The lock is held until the next sink returns, since it receives a
+        // reference to the accumulator itself.
+        std::lock_guard<MutexOrNull<Mutex>> lock(*mutex);
+
+        transform(*accum, std::forward<decltype(inputs)>(inputs)...);
+        return newNext(const_cast<const Accumulator &>(*accum));
+      });
+    }
+
+  private:
+    Accumulator _initial;
+    Transform _transform;
+};
+
+/// Implements atomicScan().
+template<typename Accumulator, typename Transform>
+struct AtomicScanOperator final
+{
+  public:
+    static_assert(std::is_trivially_copyable<Accumulator>::value, "atomicScan() requires an accumulator which can be stored in a std::atomic");
+
+    AtomicScanOperator () = delete;
+
+    explicit AtomicScanOperator (Accumulator initialValue, const Transform &transform) noexcept(std::is_nothrow_copy_constructible<Transform>::value)
+      : _initial(initialValue)
+      , _transform(transform)
+    {}
+
+    explicit AtomicScanOperator (Accumulator initialValue, Transform &&transform) noexcept(std::is_nothrow_move_constructible<Transform>::value)
+      : _initial(initialValue)
+      , _transform(std::move(transform))
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      return makeBlockConvertible([newNext = std::move(newNext), transform = _transform, accum = std::make_shared<std::atomic<Accumulator>>(_initial)](auto &&...inputs) {
+        Accumulator current = accum->load(std::memory_order_acquire);
+
+        // If another thread updates the accumulator first, the transform is
+        // invoked again with its result, so inputs must not be moved from.
+        while (true) {
+          Accumulator newAccum = transform(const_cast<const Accumulator &>(current), inputs...);
+
+          if (accum->compare_exchange_weak(current, newAccum, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return newNext(std::move(newAccum));
+          }
+        }
+      });
+    }
+
+  private:
+    Accumulator _initial;
+    Transform _transform;
+};
+
+/// Partial accumulators for shardedScan(), each of which is (usually) only
+/// updated by a subset of threads.
+template<typename Accumulator>
+class ScanShards final
+{
+  public:
+    static_assert(std::is_trivially_copyable<Accumulator>::value, "shardedScan() requires an accumulator which can be stored in a std::atomic");
+
+    ScanShards (size_t count, Accumulator identity)
+      : _shards(new Shard[count])
+      , _count(count)
+    {
+      for (size_t i = 0; i < count; i++) {
+        _shards[i]._value.store(identity, std::memory_order_relaxed);
+      }
+    }
+
+    /// The shard which the calling thread should update.
+    std::atomic<Accumulator> &current () noexcept
+    {
+      return _shards[currentThreadIndex() % _count]._value;
+    }
+
+    /// Combines every shard's partial accumulator, using the given function
+    /// (which should accept two accumulators).
+    template<typename Merge>
+    Accumulator merge (const Merge &merge) const
+    {
+      Accumulator result = _shards[0]._value.load();
+
+      for (size_t i = 1; i < _count; i++) {
+        result = merge(const_cast<const Accumulator &>(result), _shards[i]._value.load());
+      }
+
+      return result;
+    }
+
+  private:
+    struct Shard final
+    {
+      std::atomic<Accumulator> _value;
+
+      // Keeps each shard on its own cache line, so threads updating different
+      // shards don't contend.
+      char _padding[64];
+    };
+
+    std::unique_ptr<Shard[]> _shards;
+    size_t _count;
+
+    // Assigns threads to shards round-robin, in the order they first use
+    // any ScanShards of this type.
+    static size_t currentThreadIndex () noexcept
+    {
+      static std::atomic<size_t> nextIndex(0);
+      static thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+
+      return index;
+    }
+};
+
+/// Implements shardedScan().
+template<typename Accumulator, typename Transform, typename Merge>
+struct ShardedScanOperator final
+{
+  public:
+    ShardedScanOperator () = delete;
+
+    ShardedScanOperator (Accumulator identity, Transform transform, Merge merge, size_t shardCount)
+      : _identity(identity)
+      , _transform(std::move(transform))
+      , _merge(std::move(merge))
+      , _shardCount(shardCount)
+    {
+      if (shardCount == 0) {
+        throw std::invalid_argument("shardedScan() requires at least one shard");
+      }
+    }
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      return makeBlockConvertible([newNext = std::move(newNext), transform = _transform, merge = _merge, shards = std::make_shared<ScanShards<Accumulator>>(_shardCount, _identity)](auto &&...inputs) {
+        std::atomic<Accumulator> &shard = shards->current();
+        Accumulator current = shard.load();
+
+        // Contention here only comes from other threads that share this
+        // shard, which is rare unless there are more threads than shards.
+        while (!shard.compare_exchange_weak(current, transform(const_cast<const Accumulator &>(current), inputs...))) {
+        }
+
+        // This still reads every shard, so their cache lines are shared with
+        // (and invalidated by) every other writer. See shardedScan().
+        return newNext(shards->merge(merge));
+      });
+    }
+
+  private:
+    Accumulator _identity;
+    Transform _transform;
+    Merge _merge;
+    size_t _shardCount;
+};
+
 /// Implements onError().
 template<typename Handler>
 struct ErrorOperator final
@@ -184,12 +391,12 @@ struct ErrorOperator final
     {
       return makeBlockConvertible([newNext = std::move(newNext), handler = _handler](auto &&...inputs) {
         error_type error{};
-        auto inputsWithoutError = extract(std::make_tuple(std::forward<decltype(inputs)>(inputs)...), &error);
+        auto inputsWithoutError = extract(&error, std::forward<decltype(inputs)>(inputs)...);
 
         if (error) {
           return handler(error);
         } else {
-          return callWithTuple(newNext, inputsWithoutError);
+          return callWithTuple(newNext, std::move(inputsWithoutError));
         }
       });
     }
@@ -220,12 +427,12 @@ struct RecoverOperator final
     {
       return makeBlockConvertible([newNext = std::move(newNext), handler = _handler](auto &&...inputs) {
         error_type error{};
-        auto inputsWithoutError = extract(std::make_tuple(std::forward<decltype(inputs)>(inputs)...), &error);
+        auto inputsWithoutError = extract(&error, std::forward<decltype(inputs)>(inputs)...);
 
         if (error) {
           return newNext(handler(error));
         } else {
-          return newNext(std::get<0>(inputsWithoutError));
+          return newNext(std::get<0>(std::move(inputsWithoutError)));
         }
       });
     }
@@ -234,30 +441,244 @@ struct RecoverOperator final
     Handler _handler;
 };
 
-/// One of the input sinks to a CombineOperator.
+/// One input's most recent value within a CombineState, which is copied into
+/// each combined result.
+template<typename Value>
+struct CombineSlot final
+{
+  public:
+    /// The type of the next sink's parameter for this input.
+    using argument_type = Value;
+
+    /// The type which snapshots of this slot are copied into.
+    using snapshot_type = Value;
+
+    // Held only while storing or copying _value, so writers to different
+    // slots never wait on each other.
+    std::mutex _mutex;
+
+    // Incremented each time _value is replaced. This is only written while
+    // holding _mutex, but can be read without it.
+    std::atomic<uint64_t> _version;
+
+    Optional<Value> _value;
+
+    // Reduces false sharing between the locks of adjacent slots.
+    char _padding[64];
+
+    CombineSlot () noexcept
+      : _version(0)
+    {}
+
+    void store (Value value)
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+
+      _value = std::move(value);
+      _version.store(_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// Copies the current value, which must exist, also returning the version
+    /// it corresponds to.
+    snapshot_type copy (uint64_t &version)
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+
+      version = _version.load(std::memory_order_relaxed);
+      return copyLocked();
+    }
+
+    /// Like copy(), but must be called while already holding _mutex.
+    snapshot_type copyLocked () const
+    {
+      return *_value;
+    }
+
+    /// Converts a snapshot into the argument for the next sink.
+    static Value &&forward (snapshot_type &snapshot) noexcept
+    {
+      return std::move(snapshot);
+    }
+};
+
+/// One input's most recent value within a CombineState, which is kept behind
+/// a std::shared_ptr so that combined results can refer to it without copying.
+template<typename Value>
+struct SharedCombineSlot final
+{
+  public:
+    using argument_type = const Value &;
+    using snapshot_type = std::shared_ptr<const Value>;
+
+    std::mutex _mutex;
+    std::atomic<uint64_t> _version;
+    std::shared_ptr<const Value> _value;
+    char _padding[64];
+
+    SharedCombineSlot () noexcept
+      : _version(0)
+    {}
+
+    void store (Value value)
+    {
+      // Allocate before locking, and destroy the previous value after
+      // unlocking, so the lock is only held for a pointer swap.
+      auto newValue = std::make_shared<const Value>(std::move(value));
+
+      std::lock_guard<std::mutex> guard(_mutex);
+
+      _value.swap(newValue);
+      _version.store(_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    snapshot_type copy (uint64_t &version)
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+
+      version = _version.load(std::memory_order_relaxed);
+      return copyLocked();
+    }
+
+    snapshot_type copyLocked () const
+    {
+      return _value;
+    }
+
+    static const Value &forward (snapshot_type &snapshot) noexcept
+    {
+      return *snapshot;
+    }
+};
+
+/// The shared state behind the sinks of a CombineOperator.
+///
+/// Each input is stored in its own slot (of type `Slot<Value>`), and a
+/// bitmask records which inputs have arrived at least once. Once every input
+/// has arrived, emit() snapshots all of them without blocking any writers that
+/// aren't also snapshotting.
+template<template<typename> class Slot, typename... Values>
+class CombineState final
+{
+  public:
+    static_assert(sizeof...(Values) <= 64, "CombineOperator supports at most 64 inputs");
+
+    using tuple_type = std::tuple<Values...>;
+
+    /// The type of the next sink, given the type it returns.
+    template<typename NextResult>
+    using next_type = std::function<NextResult(typename Slot<Values>::argument_type...)>;
+
+    CombineState () noexcept
+      : _ready(0)
+    {}
+
+    CombineState (const CombineState &) = delete;
+    CombineState &operator= (const CombineState &) = delete;
+
+    /// Replaces the value of the given input.
+    ///
+    /// Returns whether every input now has a value.
+    template<size_t Index>
+    bool store (std::tuple_element_t<Index, tuple_type> value)
+    {
+      std::get<Index>(_slots).store(std::move(value));
+
+      uint64_t bit = uint64_t(1) << Index;
+      uint64_t ready = _ready.load(std::memory_order_acquire);
+
+      if (!(ready & bit)) {
+        ready = _ready.fetch_or(bit, std::memory_order_acq_rel) | bit;
+      }
+
+      return ready == allReady();
+    }
+
+    /// Invokes the next sink with the value of every input, as they all were
+    /// at some single moment during this call. Every input must already have
+    /// a value.
+    template<typename Next>
+    decltype(auto) emit (const Next &next)
+    {
+      return emit(next, std::index_sequence_for<Values...>());
+    }
+
+  private:
+    using snapshot_type = std::tuple<typename Slot<Values>::snapshot_type...>;
+
+    // How many times a snapshot will try to copy the inputs without locking
+    // them all together, before giving up and doing so.
+    static constexpr unsigned maxOptimisticSnapshots = 4;
+
+    template<size_t>
+    using SlotLock = std::unique_lock<std::mutex>;
+
+    std::tuple<Slot<Values>...> _slots;
+    std::atomic<uint64_t> _ready;
+
+    static constexpr uint64_t allReady () noexcept
+    {
+      return sizeof...(Values) == 64 ? ~uint64_t(0) : (uint64_t(1) << sizeof...(Values)) - 1;
+    }
+
+    template<typename Next, size_t... Indices>
+    decltype(auto) emit (const Next &next, std::index_sequence<Indices...> indices)
+    {
+      auto values = snapshot(indices);
+      return next(Slot<Values>::forward(std::get<Indices>(values))...);
+    }
+
+    template<size_t... Indices>
+    snapshot_type snapshot (std::index_sequence<Indices...>)
+    {
+      for (unsigned attempt = 0; attempt < maxOptimisticSnapshots; attempt++) {
+        uint64_t versions[sizeof...(Values)];
+        snapshot_type values{std::get<Indices>(_slots).copy(versions[Indices])...};
+
+        // Each slot was copied at a different time, but if none of them have
+        // changed since, then they all held those values just after the last
+        // copy.
+        bool unchanged = true;
+        (void)std::initializer_list<int>{(unchanged = unchanged && std::get<Indices>(_slots)._version.load(std::memory_order_acquire) == versions[Indices], 0)...};
+
+        if (unchanged) {
+          return values;
+        }
+      }
+
+      // Writers keep getting in the way, so block them instead. Slots are
+      // always locked in index order (which braced initialization
+      // guarantees), so this cannot deadlock with another snapshot.
+      std::tuple<SlotLock<Indices>...> locks{SlotLock<Indices>(std::get<Indices>(_slots)._mutex)...};
+      (void)locks;
+
+      return snapshot_type{std::get<Indices>(_slots).copyLocked()...};
+    }
+};
+
+/// One of the input sinks to a CombineOperator or SharedCombineOperator.
 ///
 /// This type of sink cannot be constructed directly. It is only obtained by
-/// calling CombineOperator::sinks().
-template<typename NextResult, size_t Index, typename... Values>
+/// calling BasicCombineOperator::sinks().
+///
+/// Input sinks are safe to invoke concurrently, from any threads. Each
+/// combined result is a consistent snapshot of the inputs, but results from
+/// concurrent invocations may reach the next sink in any order.
+template<typename NextResult, size_t Index, typename State>
 struct CombineInputOperator final
 {
   public:
-    using tuple_type = std::tuple<Values...>;
-    using input_type = std::tuple<Optional<Values>...>;
-    using storage_type = std::shared_ptr<input_type>;
+    using tuple_type = typename State::tuple_type;
+    using storage_type = std::shared_ptr<State>;
 
     using result_type = Optional<NextResult>;
-    using next_type = std::function<NextResult(Values...)>;
+    using next_type = typename State::template next_type<NextResult>;
 
     CombineInputOperator () = delete;
 
     result_type operator() (std::tuple_element_t<Index, tuple_type> value) const
     {
-      // TODO: Thread safety
-      std::get<Index>(*_values) = std::move(value);
-
-      if (auto repacked = flattenOptionals<0, input_type, Values...>(*_values)) {
-        return result_type(callWithTuple(_next, std::move(*repacked)));
+      if (_values->template store<Index>(std::move(value))) {
+        return result_type(_values->emit(_next));
       } else {
         return result_type();
       }
@@ -274,30 +695,26 @@ struct CombineInputOperator final
 
     storage_type _values;
 
-    template<typename X, typename... XS>
-    friend class CombineOperator;
+    template<template<typename> class S, typename X, typename... XS>
+    friend class BasicCombineOperator;
 };
 
-template<size_t Index, typename... Values>
-struct CombineInputOperator<void, Index, Values...> final
+template<size_t Index, typename State>
+struct CombineInputOperator<void, Index, State> final
 {
   public:
-    using tuple_type = std::tuple<Values...>;
-    using input_type = std::tuple<Optional<Values>...>;
-    using storage_type = std::shared_ptr<input_type>;
+    using tuple_type = typename State::tuple_type;
+    using storage_type = std::shared_ptr<State>;
 
     using result_type = bool;
-    using next_type = std::function<void(Values...)>;
+    using next_type = typename State::template next_type<void>;
 
     CombineInputOperator () = delete;
 
     result_type operator() (std::tuple_element_t<Index, tuple_type> value) const
     {
-      // TODO: Thread safety
-      std::get<Index>(*_values) = std::move(value);
-
-      if (auto repacked = flattenOptionals<0, input_type, Values...>(*_values)) {
-        callWithTuple(_next, std::move(*repacked));
+      if (_values->template store<Index>(std::move(value))) {
+        _values->emit(_next);
         return true;
       } else {
         return false;
@@ -313,27 +730,31 @@ struct CombineInputOperator<void, Index, Values...> final
     next_type _next;
     storage_type _values;
 
-    template<typename X, typename... XS>
-    friend class CombineOperator;
+    template<template<typename> class S, typename X, typename... XS>
+    friend class BasicCombineOperator;
 };
 
 /// Combines N different inputs and forwards them to another sink as one
 /// argument list.
-template<typename NextResult, typename... Values>
-class CombineOperator final
+///
+/// `Slot` determines how each input is stored and passed along. Use the
+/// CombineOperator or SharedCombineOperator aliases instead of naming this
+/// directly.
+template<template<typename> class Slot, typename NextResult, typename... Values>
+class BasicCombineOperator final
 {
   public:
-    using input_type = std::tuple<Optional<Values>...>;
+    using state_type = CombineState<Slot, Values...>;
     using tuple_type = std::tuple<Values...>;
 
     using result_type = Optional<NextResult>;
-    using next_type = std::function<NextResult(Values...)>;
+    using next_type = typename state_type::template next_type<NextResult>;
 
-    CombineOperator () = delete;
+    BasicCombineOperator () = delete;
 
-    explicit CombineOperator (next_type next)
+    explicit BasicCombineOperator (next_type next)
       : _next(std::move(next))
-      , _values(std::make_shared<input_type>(Optional<Values>()...))
+      , _values(std::make_shared<state_type>())
     {}
 
     // Returns a tuple of CombineInputOperators, corresponding to each input.
@@ -344,7 +765,7 @@ class CombineOperator final
 
   private:
     next_type _next;
-    std::shared_ptr<input_type> _values;
+    std::shared_ptr<state_type> _values;
 
     /// Generates the sinks which accept each of the separate inputs to the
     /// CombineOperator.
@@ -356,7 +777,7 @@ class CombineOperator final
     template<size_t Index, typename Value, typename... Rest>
     auto generateOperators ()
     {
-      CombineInputOperator<NextResult, Index, Values...> sink(_next, _values);
+      CombineInputOperator<NextResult, Index, state_type> sink(_next, _values);
       return std::tuple_cat(std::make_tuple(std::move(sink)), generateOperators<Index + 1, Rest...>());
     }
 
@@ -367,8 +788,260 @@ class CombineOperator final
     }
 };
 
+/// Combines N different inputs and forwards copies of them to another sink.
+template<typename NextResult, typename... Values>
+using CombineOperator = BasicCombineOperator<CombineSlot, NextResult, Values...>;
+
+/// Like CombineOperator, but keeps each input behind a std::shared_ptr and
+/// passes them to the next sink by const reference, so emitting a combined
+/// result never copies the values themselves.
+///
+/// This costs an allocation per input instead, so it's best suited to large
+/// values (e.g., containers or configuration objects) which change less often
+/// than they're combined.
+template<typename NextResult, typename... Values>
+using SharedCombineOperator = BasicCombineOperator<SharedCombineSlot, NextResult, Values...>;
+
+/// Adapts the result of a combining sink's next sink into the result of the
+/// input sink: an Optional, which is empty until every input has arrived, or a
+/// bool for sinks that return nothing.
+template<typename NextResult>
+struct CombineEmitter final
+{
+  public:
+    using result_type = Optional<NextResult>;
+
+    template<typename State, typename Next>
+    static result_type emit (State &state, const Next &next)
+    {
+      return result_type(state.emit(next));
+    }
+
+    static result_type skip () noexcept
+    {
+      return result_type();
+    }
+};
+
+template<>
+struct CombineEmitter<void> final
+{
+  public:
+    using result_type = bool;
+
+    template<typename State, typename Next>
+    static result_type emit (State &state, const Next &next)
+    {
+      state.emit(next);
+      return true;
+    }
+
+    static result_type skip () noexcept
+    {
+      return false;
+    }
+};
+
+/// The state shared by every input sink from combine(): the inputs, and the
+/// single copy of the next sink.
+template<typename Next, template<typename> class Slot, typename... Values>
+struct StaticCombineState final
+{
+  public:
+    using state_type = CombineState<Slot, Values...>;
+    using next_result_type = decltype(std::declval<const Next &>()(std::declval<typename Slot<Values>::argument_type>()...));
+
+    state_type _state;
+    const Next _next;
+
+    explicit StaticCombineState (Next next) noexcept(std::is_nothrow_move_constructible<Next>::value)
+      : _next(std::move(next))
+    {}
+};
+
+/// One of the input sinks returned by combine().
+///
+/// Unlike CombineInputOperator, this knows the exact type of the next sink, so
+/// calls into it can be inlined.
+template<size_t Index, typename Shared>
+struct StaticCombineInputOperator final
+{
+  public:
+    using tuple_type = typename Shared::state_type::tuple_type;
+    using emitter_type = CombineEmitter<typename Shared::next_result_type>;
+    using result_type = typename emitter_type::result_type;
+
+    StaticCombineInputOperator () = delete;
+
+    explicit StaticCombineInputOperator (std::shared_ptr<Shared> shared) noexcept
+      : _shared(std::move(shared))
+    {}
+
+    result_type operator() (std::tuple_element_t<Index, tuple_type> value) const
+    {
+      if (_shared->_state.template store<Index>(std::move(value))) {
+        return emitter_type::emit(_shared->_state, _shared->_next);
+      } else {
+        return emitter_type::skip();
+      }
+    }
+
+  private:
+    std::shared_ptr<Shared> _shared;
+};
+
+/// Creates the input sinks for combine() and combineShared().
+template<template<typename> class Slot, typename... Values, typename Next, size_t... Indices>
+auto makeStaticCombineSinks (Next next, std::index_sequence<Indices...>)
+{
+  using Shared = StaticCombineState<Next, Slot, Values...>;
+
+  auto shared = std::make_shared<Shared>(std::move(next));
+  return std::make_tuple(StaticCombineInputOperator<Indices, Shared>(shared)...);
+}
+
+/// The state shared by every input sink from combineN().
+///
+/// Values are stored contiguously, and readiness is tracked by counting the
+/// inputs which haven't arrived yet, so each update is O(1) until the next
+/// sink is invoked. `Mutex` guards the values (and is held while invoking the
+/// next sink), or may be `void` to use no locking at all.
+template<typename T, typename Mutex, typename Next>
+class CombineNState final
+{
+  public:
+    using value_type = T;
+    using next_result_type = decltype(std::declval<const Next &>()(std::declval<ArrayView<T>>()));
+    using emitter_type = CombineEmitter<next_result_type>;
+    using result_type = typename emitter_type::result_type;
+
+    CombineNState (size_t count, Next next)
+      : _values(count)
+      , _arrived(count, false)
+      , _missing(count)
+      , _next(std::move(next))
+    {}
+
+    CombineNState (const CombineNState &) = delete;
+    CombineNState &operator= (const CombineNState &) = delete;
+
+    result_type store (size_t index, T value)
+    {
+      std::unique_lock<mutex_type> lock(_mutex);
+
+      _values[index] = std::move(value);
+
+      if (!_arrived[index]) {
+        _arrived[index] = true;
+        _missing--;
+      }
+
+      if (_missing == 0) {
+        return emitter_type::emit(*this, _next);
+      } else {
+        return emitter_type::skip();
+      }
+    }
+
+    /// Invokes the next sink with a view of every input. This must be called
+    /// while holding the lock.
+    next_result_type emit (const Next &next) const
+    {
+      return next(ArrayView<T>(_values.data(), _values.size()));
+    }
+
+  private:
+    using mutex_type = MutexOrNull<Mutex>;
+
+    mutex_type _mutex;
+
+    // These fields must be synchronized on _mutex.
+    std::vector<T> _values;
+    std::vector<bool> _arrived;
+    size_t _missing;
+
+    const Next _next;
+};
+
+/// One of the input sinks returned by combineN().
+template<typename State>
+struct CombineNInputOperator final
+{
+  public:
+    using result_type = typename State::result_type;
+
+    CombineNInputOperator () = delete;
+
+    CombineNInputOperator (std::shared_ptr<State> state, size_t index) noexcept
+      : _state(std::move(state))
+      , _index(index)
+    {}
+
+    result_type operator() (typename State::value_type value) const
+    {
+      return _state->store(_index, std::move(value));
+    }
+
+  private:
+    std::shared_ptr<State> _state;
+    size_t _index;
+};
+
+/// A result policy for scheduleOn(), which discards the result of the
+/// scheduled sink. This uses the scheduler's post() method, so nothing is
+/// allocated to track the result.
+struct DiscardResult final
+{
+  public:
+    template<typename Scheduler, typename Next, typename... Inputs>
+    static void schedule (Scheduler &scheduler, const Next &next, Inputs &&...inputs)
+    {
+      scheduler.post(next, std::forward<Inputs>(inputs)...);
+    }
+
+    template<typename Scheduler, typename Next, typename... Inputs>
+    static void schedule (Scheduler &scheduler, SchedulingPriority priority, const Next &next, Inputs &&...inputs)
+    {
+      scheduler.post(priority, next, std::forward<Inputs>(inputs)...);
+    }
+};
+
+/// A result policy for scheduleOn(), which returns a std::future for the
+/// result of the scheduled sink. This uses the scheduler's schedule() method.
+struct FutureResult final
+{
+  public:
+    template<typename Scheduler, typename Next, typename... Inputs>
+    static auto schedule (Scheduler &scheduler, const Next &next, Inputs &&...inputs)
+    {
+      return scheduler.schedule(next, std::forward<Inputs>(inputs)...);
+    }
+
+    template<typename Scheduler, typename Next, typename... Inputs>
+    static auto schedule (Scheduler &scheduler, SchedulingPriority priority, const Next &next, Inputs &&...inputs)
+    {
+      return scheduler.schedule(priority, next, std::forward<Inputs>(inputs)...);
+    }
+};
+
+/// A result policy for scheduleOn(), which runs the scheduled sink
+/// immediately when it's invoked from the scheduler itself (and nothing is
+/// queued ahead of it), or posts it otherwise. The result is discarded.
+///
+/// This uses the scheduler's dispatch() method, so consecutive stages on the
+/// same scheduler don't pay for an extra enqueue and wakeup.
+struct InlineWhenCurrent final
+{
+  public:
+    template<typename Scheduler, typename Next, typename... Inputs>
+    static void schedule (Scheduler &scheduler, const Next &next, Inputs &&...inputs)
+    {
+      scheduler.dispatch(next, std::forward<Inputs>(inputs)...);
+    }
+};
+
 /// Implements scheduleOn().
-template<typename Scheduler>
+template<typename Scheduler, typename ResultPolicy = DiscardResult>
 struct SchedulingOperator final
 {
   public:
@@ -390,11 +1063,288 @@ struct SchedulingOperator final
       return makeBlockConvertible([newNext = std::move(newNext), scheduler = _scheduler](auto &&...inputs) {
         auto mutableScheduler = const_cast<std::remove_const_t<Scheduler> *>(scheduler.get());
 
-        return mutableScheduler->schedule(newNext, std::forward<decltype(inputs)>(inputs)...);
+        return ResultPolicy::schedule(*mutableScheduler, newNext, std::forward<decltype(inputs)>(inputs)...);
+      });
+    }
+
+  private:
+    scheduler_type _scheduler;
+};
+
+/// Implements scheduleOn() with a SchedulingPriority.
+template<typename Scheduler, typename ResultPolicy = DiscardResult>
+struct PrioritizedSchedulingOperator final
+{
+  public:
+    using scheduler_type = std::shared_ptr<Scheduler>;
+
+    PrioritizedSchedulingOperator () = delete;
+
+    PrioritizedSchedulingOperator (scheduler_type scheduler, SchedulingPriority priority) noexcept(std::is_nothrow_move_constructible<scheduler_type>::value)
+      : _scheduler(std::move(scheduler))
+      , _priority(priority)
+    {}
+
+    PrioritizedSchedulingOperator (Scheduler &&scheduler, SchedulingPriority priority)
+      : _scheduler(std::make_shared<Scheduler>(std::move(scheduler)))
+      , _priority(priority)
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      return makeBlockConvertible([newNext = std::move(newNext), scheduler = _scheduler, priority = _priority](auto &&...inputs) {
+        auto mutableScheduler = const_cast<std::remove_const_t<Scheduler> *>(scheduler.get());
+
+        return ResultPolicy::schedule(*mutableScheduler, priority, newNext, std::forward<decltype(inputs)>(inputs)...);
+      });
+    }
+
+  private:
+    scheduler_type _scheduler;
+    SchedulingPriority _priority;
+};
+
+/// Implements scheduleLatestOn().
+template<typename Scheduler>
+struct ConflatingSchedulingOperator final
+{
+  public:
+    using scheduler_type = std::shared_ptr<Scheduler>;
+
+    ConflatingSchedulingOperator () = delete;
+
+    explicit ConflatingSchedulingOperator (scheduler_type scheduler) noexcept(std::is_nothrow_move_constructible<scheduler_type>::value)
+      : _scheduler(std::move(scheduler))
+    {}
+
+    explicit ConflatingSchedulingOperator (Scheduler &&scheduler)
+      : _scheduler(std::make_shared<Scheduler>(std::move(scheduler)))
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      auto mailbox = std::make_shared<Mailbox<NewNext>>(std::move(newNext));
+
+      return makeBlockConvertible([mailbox, scheduler = _scheduler](auto &&...inputs) {
+        auto mutableScheduler = const_cast<std::remove_const_t<Scheduler> *>(scheduler.get());
+
+        {
+          std::lock_guard<std::mutex> guard(mailbox->_mutex);
+
+          Mailbox<NewNext> *unowned = mailbox.get();
+          mailbox->_pending = [unowned, arguments = std::make_tuple(std::forward<decltype(inputs)>(inputs)...)]() mutable {
+            callWithTuple(unowned->_next, std::move(arguments));
+          };
+
+          if (mailbox->_scheduled) {
+            return;
+          }
+
+          mailbox->_scheduled = true;
+        }
+
+        // If this throws, destroying the drain lets the next input try again.
+        // Clearing _scheduled here as well could race with a drain posted by
+        // another input in the meantime.
+        mutableScheduler->post(Drain<NewNext>(mailbox));
+      });
+    }
+
+  private:
+    /// Holds the most recent input for one composed sink.
+    template<typename Next>
+    struct Mailbox final
+    {
+      Next _next;
+
+      // These fields must be synchronized on _mutex.
+      std::mutex _mutex;
+      Task _pending;
+      bool _scheduled;
+
+      explicit Mailbox (Next next)
+        : _next(std::move(next))
+        , _scheduled(false)
+      {}
+    };
+
+    /// The action posted to forward a Mailbox's pending input.
+    ///
+    /// If a bounded scheduler drops or rejects this without running it, the
+    /// destructor clears the mailbox's _scheduled flag, so that later inputs still post a
+    /// new drain instead of waiting forever for this one.
+    template<typename Next>
+    struct Drain final
+    {
+      std::shared_ptr<Mailbox<Next>> _mailbox;
+
+      explicit Drain (std::shared_ptr<Mailbox<Next>> mailbox) noexcept
+        : _mailbox(std::move(mailbox))
+      {}
+
+      Drain (Drain &&) noexcept = default;
+      Drain &operator= (Drain &&) noexcept = default;
+
+      ~Drain ()
+      {
+        if (_mailbox) {
+          std::lock_guard<std::mutex> guard(_mailbox->_mutex);
+          _mailbox->_scheduled = false;
+        }
+      }
+
+      void operator() ()
+      {
+        // Once run, the destructor has nothing left to do.
+        auto mailbox = std::move(_mailbox);
+        Task pending;
+
+        {
+          std::lock_guard<std::mutex> guard(mailbox->_mutex);
+
+          pending = std::move(mailbox->_pending);
+          mailbox->_scheduled = false;
+        }
+
+        // Another drain may have raced this one, and taken the input first.
+        if (pending) {
+          pending();
+        }
+      }
+    };
+
+    scheduler_type _scheduler;
+};
+
+/// The current time according to the given scheduler's own clock, if it has
+/// one (like VirtualTimeScheduler does), or else the steady clock's.
+template<typename Scheduler>
+auto currentTimeOn (const Scheduler &scheduler, int) -> decltype(scheduler.now())
+{
+  return scheduler.now();
+}
+
+template<typename Scheduler>
+std::chrono::steady_clock::time_point currentTimeOn (const Scheduler &, long)
+{
+  return std::chrono::steady_clock::now();
+}
+
+/// Implements buffer().
+template<typename T, typename Scheduler>
+struct BufferOperator final
+{
+  public:
+    using scheduler_type = std::shared_ptr<Scheduler>;
+
+    BufferOperator () = delete;
+
+    BufferOperator (size_t maxCount, std::chrono::nanoseconds maxDelay, scheduler_type scheduler) noexcept(std::is_nothrow_move_constructible<scheduler_type>::value)
+      : _maxCount(maxCount)
+      , _maxDelay(maxDelay)
+      , _scheduler(std::move(scheduler))
+    {}
+
+    BufferOperator (size_t maxCount, std::chrono::nanoseconds maxDelay, Scheduler &&scheduler)
+      : _maxCount(maxCount)
+      , _maxDelay(maxDelay)
+      , _scheduler(std::make_shared<Scheduler>(std::move(scheduler)))
+    {}
+
+    template<typename NewNext>
+    auto compose (NewNext newNext) const
+    {
+      auto batch = std::make_shared<Batch<NewNext>>(std::move(newNext), _maxCount);
+
+      return makeBlockConvertible([batch, maxDelay = _maxDelay, scheduler = _scheduler](T value) {
+        uint64_t generation;
+
+        {
+          std::lock_guard<std::mutex> guard(batch->_mutex);
+
+          batch->_items.push_back(std::move(value));
+
+          if (batch->_items.size() >= batch->_maxCount) {
+            batch->flush();
+            return;
+          } else if (batch->_items.size() > 1) {
+            return;
+          }
+
+          generation = batch->_generation;
+        }
+
+        // This is the first input of a new batch, so start its timer. By the
+        // time it fires, the batch may already have been forwarded for being
+        // full, in which case the generation will have changed.
+        auto mutableScheduler = const_cast<std::remove_const_t<Scheduler> *>(scheduler.get());
+        auto now = currentTimeOn(*mutableScheduler, 0);
+        auto deadline = now + std::chrono::duration_cast<typename decltype(now)::duration>(maxDelay);
+
+        mutableScheduler->scheduleAfter(deadline, [batch, generation] {
+          std::lock_guard<std::mutex> guard(batch->_mutex);
+
+          if (batch->_generation == generation) {
+            batch->flush();
+          }
+        });
       });
     }
 
   private:
+    /// Collects inputs for one composed sink.
+    template<typename Next>
+    struct Batch final
+    {
+      Next _next;
+      size_t _maxCount;
+
+      // These fields must be synchronized on _mutex, which is also held while
+      // invoking _next, so batches are forwarded one at a time and in order.
+      std::mutex _mutex;
+      std::vector<T> _items;
+
+      // Incremented each time the batch is forwarded, so that timers for
+      // earlier batches can tell they're stale.
+      uint64_t _generation;
+
+      Batch (Next next, size_t maxCount)
+        : _next(std::move(next))
+        , _maxCount(maxCount)
+        , _generation(0)
+      {
+        _items.reserve(maxCount);
+      }
+
+      // Must be called while holding _mutex.
+      void flush ()
+      {
+        if (_items.empty()) {
+          return;
+        }
+
+        _generation++;
+
+        // Clear the batch afterward (even if _next throws), keeping its
+        // capacity for the next one.
+        struct Clearer final
+        {
+          std::vector<T> &_items;
+
+          ~Clearer ()
+          {
+            _items.clear();
+          }
+        } clearer{_items};
+
+        _next(const_cast<const std::vector<T> &>(_items));
+      }
+    };
+
+    size_t _maxCount;
+    std::chrono::nanoseconds _maxDelay;
     scheduler_type _scheduler;
 };
 
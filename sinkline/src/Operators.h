@@ -10,10 +10,14 @@
 #ifndef FB_SINKLINE_OPERATORS_H
 #define FB_SINKLINE_OPERATORS_H
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "AnyNull.h"
 #include "OperatorDefinitions.h"
@@ -71,6 +75,69 @@ static inline auto ignoreNull ()
   });
 }
 
+/// Combines N different inputs and forwards copies of them to the given sink,
+/// once every input has arrived.
+///
+/// Returns a tuple of input sinks, one for each of `Values`. For example:
+///
+///   auto sinks = combine<int, std::string>([](int count, std::string name) {
+///     ...
+///   });
+///
+///   std::get<0>(sinks)(5);
+///   std::get<1>(sinks)("foobar");
+///
+/// This behaves like CombineOperator, but stores the sink once (shared by
+/// every input), without wrapping it in a std::function.
+template<typename... Values, typename Next>
+auto combine (Next &&next)
+{
+  return makeStaticCombineSinks<CombineSlot, Values...>(std::decay_t<Next>(std::forward<Next>(next)), std::index_sequence_for<Values...>());
+}
+
+/// Like combine(), but behaves like SharedCombineOperator: inputs are passed
+/// to the sink by const reference, without being copied.
+template<typename... Values, typename Next>
+auto combineShared (Next &&next)
+{
+  return makeStaticCombineSinks<SharedCombineSlot, Values...>(std::decay_t<Next>(std::forward<Next>(next)), std::index_sequence_for<Values...>());
+}
+
+/// Combines `count` inputs of the same type, chosen at runtime, and forwards
+/// them to the given sink as an ArrayView<T>, once every input has arrived.
+///
+/// Returns a std::vector of `count` input sinks. For example:
+///
+///   auto sinks = combineN<Health>(shards.size(), [](ArrayView<Health> health) {
+///     ...
+///   });
+///
+///   sinks[shardIndex](Health::Good);
+///
+/// The view is only valid during the sink's invocation. `T` must be default
+/// constructible, since storage for every input is allocated up front.
+///
+/// By default, combineN() will use a non-recursive mutex to protect its inputs,
+/// which is also held while the sink runs, so the sink must not feed back into
+/// these inputs. To construct a different mutex type, specify it (or `void`,
+/// to use none at all) for the `Mutex` template parameter.
+template<typename T, typename Mutex = std::mutex, typename Next>
+auto combineN (size_t count, Next &&next)
+{
+  using State = CombineNState<T, Mutex, std::decay_t<Next>>;
+
+  auto state = std::make_shared<State>(count, std::forward<Next>(next));
+
+  std::vector<CombineNInputOperator<State>> sinks;
+  sinks.reserve(count);
+
+  for (size_t i = 0; i < count; i++) {
+    sinks.emplace_back(state, i);
+  }
+
+  return sinks;
+}
+
 /// Combines each new input with an accumulator, starting with the given initial
 /// value, using the new combined result as the accumulator, and forwarding it
 /// to the next operator or callback.
@@ -94,18 +161,169 @@ auto scan (Accumulator &&initialValue, Callable &&transform)
   return ScanOperator<Mutex, std::remove_reference_t<Accumulator>, std::remove_reference_t<Callable>>(std::forward<Accumulator>(initialValue), std::forward<Callable>(transform));
 }
 
+/// Like scan(), but the transform modifies the accumulator in place (taking
+/// it by non-const reference), and the next operator or callback receives a
+/// const reference to it, so the accumulator is never copied after the first
+/// invocation. For example:
+///
+///   scanInPlace(std::vector<int>(), [](std::vector<int> &values, int x) {
+///     values.push_back(x);
+///   })
+///
+/// will forward every input received so far, without copying the vector.
+///
+/// The mutex (chosen like scan()'s) is held while the next operator or
+/// callback runs, so the reference stays valid, but it must not feed back
+/// into the same sink. Anything that outlives the invocation must copy what
+/// it needs.
+template<typename Mutex = std::mutex, typename Accumulator, typename Callable>
+auto scanInPlace (Accumulator &&initialValue, Callable &&transform)
+{
+  return InPlaceScanOperator<Mutex, std::decay_t<Accumulator>, std::remove_reference_t<Callable>>(std::forward<Accumulator>(initialValue), std::forward<Callable>(transform));
+}
+
+/// Like scan(), but updates the accumulator with a compare-and-swap loop
+/// instead of a mutex. The accumulator must be trivially copyable (and should
+/// have no padding bits), so that it can be stored in a std::atomic.
+///
+/// If multiple threads invoke the sink at once, the transform may be invoked
+/// more than once for the same input, so it should have no side effects.
+template<typename Accumulator, typename Callable>
+auto atomicScan (Accumulator initialValue, Callable &&transform)
+{
+  return AtomicScanOperator<Accumulator, std::remove_reference_t<Callable>>(initialValue, std::forward<Callable>(transform));
+}
+
+/// Like scan(), but for a commutative and associative transform, which lets
+/// concurrent threads accumulate into separate shards instead of contending
+/// for one accumulator. Each forwarded value is the result of merging every
+/// shard, using `merge` (which accepts two accumulators).
+///
+/// For example:
+///
+///   shardedScan(uint64_t(0), [](uint64_t sum, uint64_t x) {
+///     return sum + x;
+///   }, std::plus<uint64_t>())
+///
+/// will count inputs from any number of threads, without them contending
+/// unless there are more threads than shards.
+///
+/// `identity` is the initial value of every shard, so it must not change the
+/// result when merged (e.g., 0 for a sum). Like atomicScan(), the accumulator
+/// must be trivially copyable, and the transform may be invoked more than once
+/// for the same input.
+///
+/// Values forwarded concurrently may not reflect a single order of inputs,
+/// but at least one of the last values forwarded will include every input.
+///
+/// Only the update is sharded, though. To forward the total, every input
+/// still merges every shard, which costs O(shardCount) and reads cache lines
+/// that other threads are writing. This helps most when the transform is
+/// expensive or retried often under contention; for a cheap transform (like
+/// a counter), benchmark against atomicScan() first.
+///
+/// By default, there is one shard per hardware thread. `shardCount` must be
+/// at least 1, or std::invalid_argument is thrown.
+template<typename Accumulator, typename Callable, typename Merge>
+auto shardedScan (Accumulator identity, Callable &&transform, Merge &&merge, size_t shardCount = std::max(1u, std::thread::hardware_concurrency()))
+{
+  return ShardedScanOperator<Accumulator, std::decay_t<Callable>, std::decay_t<Merge>>(identity, std::forward<Callable>(transform), std::forward<Merge>(merge), shardCount);
+}
+
+/// Like shardedScan(), but uses the transform to merge shards as well. This
+/// requires that the inputs have the same type as the accumulator.
+template<typename Accumulator, typename Callable>
+auto shardedScan (Accumulator identity, Callable &&transform)
+{
+  auto merge = transform;
+  return shardedScan(identity, std::forward<Callable>(transform), std::move(merge));
+}
+
 /// Forwards each input while running on the given scheduler. This can be used
 /// to specify which thread or queue further processing should happen upon.
-template<typename Scheduler>
+///
+/// By default, the results of further processing are discarded, and invoking
+/// the sink returns nothing. To receive a std::future for each result instead,
+/// specify `FutureResult` for the `ResultPolicy` template parameter. To run
+/// inputs immediately when they already arrive on the scheduler, specify
+/// `InlineWhenCurrent`.
+template<typename ResultPolicy = DiscardResult, typename Scheduler>
 auto scheduleOn (std::shared_ptr<Scheduler> scheduler)
 {
-  return SchedulingOperator<Scheduler>(std::move(scheduler));
+  return SchedulingOperator<Scheduler, ResultPolicy>(std::move(scheduler));
 }
 
-template<typename Scheduler>
+template<typename ResultPolicy = DiscardResult, typename Scheduler>
 auto scheduleOn (Scheduler &&scheduler)
 {
-  return SchedulingOperator<Scheduler>(std::move(scheduler));
+  return SchedulingOperator<Scheduler, ResultPolicy>(std::move(scheduler));
+}
+
+/// Like scheduleOn(), but schedules each input in the lane for the given
+/// priority. The scheduler must support prioritized scheduling (like
+/// ThreadScheduler does).
+template<typename ResultPolicy = DiscardResult, typename Scheduler>
+auto scheduleOn (std::shared_ptr<Scheduler> scheduler, SchedulingPriority priority)
+{
+  return PrioritizedSchedulingOperator<Scheduler, ResultPolicy>(std::move(scheduler), priority);
+}
+
+template<typename ResultPolicy = DiscardResult, typename Scheduler>
+auto scheduleOn (Scheduler &&scheduler, SchedulingPriority priority)
+{
+  return PrioritizedSchedulingOperator<Scheduler, ResultPolicy>(std::move(scheduler), priority);
+}
+
+/// Like scheduleOn(), but only forwards the most recent input.
+///
+/// Each composed sink keeps a single pending slot, which every input
+/// overwrites. At most one action per sink is queued on the scheduler at a
+/// time, and when it runs, it forwards whichever input is latest. This is
+/// useful when stale values are worthless (e.g., for UI updates or metrics),
+/// and a slow consumer should skip them instead of falling behind.
+///
+/// The results of further processing are discarded.
+template<typename Scheduler>
+auto scheduleLatestOn (std::shared_ptr<Scheduler> scheduler)
+{
+  return ConflatingSchedulingOperator<Scheduler>(std::move(scheduler));
+}
+
+template<typename Scheduler>
+auto scheduleLatestOn (Scheduler &&scheduler)
+{
+  return ConflatingSchedulingOperator<Scheduler>(std::move(scheduler));
+}
+
+/// Collects inputs of type `T` into batches, which are forwarded as a
+/// `const std::vector<T> &` once `maxCount` inputs have arrived, or `maxDelay`
+/// after the first input of the batch, whichever comes first.
+///
+/// For example:
+///
+///   buffer<LogEntry>(512, std::chrono::milliseconds(100), ThreadScheduler())
+///
+/// will write entries in batches of up to 512, but never hold onto one for
+/// more than about 100ms.
+///
+/// Full batches are forwarded upon the thread which completed them, and
+/// timed-out batches upon the given scheduler, which must support
+/// scheduleAfter(). Either way, only one batch is forwarded at a time, in
+/// order, and inputs wait while a batch is being forwarded. The vector is
+/// reused for every batch, so anything that outlives the invocation must copy
+/// what it needs.
+///
+/// `maxCount` must be at least 1.
+template<typename T, typename Rep, typename Period, typename Scheduler>
+auto buffer (size_t maxCount, std::chrono::duration<Rep, Period> maxDelay, std::shared_ptr<Scheduler> scheduler)
+{
+  return BufferOperator<T, Scheduler>(maxCount, std::chrono::duration_cast<std::chrono::nanoseconds>(maxDelay), std::move(scheduler));
+}
+
+template<typename T, typename Rep, typename Period, typename Scheduler>
+auto buffer (size_t maxCount, std::chrono::duration<Rep, Period> maxDelay, Scheduler &&scheduler)
+{
+  return BufferOperator<T, Scheduler>(maxCount, std::chrono::duration_cast<std::chrono::nanoseconds>(maxDelay), std::move(scheduler));
 }
 
 /// Invokes the given side effect before forwarding each input.
@@ -9,21 +9,57 @@
 
 #include "Scheduler.h"
 
+#include <algorithm>
+#include <deque>
+#include <iterator>
+
 using namespace fb::sinkline;
 
+namespace {
+
+// The state of the ThreadScheduler whose thread is the current thread, if
+// any.
+thread_local const void *currentScheduler = nullptr;
+
+// Actions queued by TrampolineScheduler on the current thread.
+struct Trampoline final
+{
+  bool _running = false;
+  std::deque<Task> _queue;
+};
+
+Trampoline &currentTrampoline () noexcept
+{
+  static thread_local Trampoline trampoline;
+  return trampoline;
+}
+
+ThreadScheduler::Options optionsYieldingBetweenActions (bool yieldBetweenActions)
+{
+  ThreadScheduler::Options options;
+  options.yieldBetweenActions = yieldBetweenActions;
+  return options;
+}
+
+}
+
 ThreadScheduler::ThreadScheduler (bool yieldBetweenActions)
-  : _state(std::make_shared<State>(yieldBetweenActions))
+  : ThreadScheduler(optionsYieldingBetweenActions(yieldBetweenActions))
+{}
+
+ThreadScheduler::ThreadScheduler (const Options &options)
+  : _state(std::make_shared<State>(options))
 {
-  std::thread([state = _state] {
+  startDetachedThread(options.placement, [state = _state] {
     detachedThreadMain(state);
-  }).detach();
+  });
 }
 
 void ThreadScheduler::suspend ()
 {
   std::lock_guard<std::mutex> guard(_state->_mutex);
 
-  if (_state->_suspensionCount == std::numeric_limits<decltype(_state->_suspensionCount)>::max()) {
+  if (_state->_suspensionCount == std::numeric_limits<unsigned>::max()) {
     throw std::overflow_error("ThreadScheduler suspension count overflow");
   }
 
@@ -32,13 +68,17 @@ void ThreadScheduler::suspend ()
 
 void ThreadScheduler::resume ()
 {
-  std::lock_guard<std::mutex> guard(_state->_mutex);
+  {
+    std::lock_guard<std::mutex> guard(_state->_mutex);
 
-  if (_state->_suspensionCount == std::numeric_limits<decltype(_state->_suspensionCount)>::min()) {
-    throw std::underflow_error("ThreadScheduler suspension count underflow (mismatched suspend/resume)");
+    if (_state->_suspensionCount == std::numeric_limits<unsigned>::min()) {
+      throw std::underflow_error("ThreadScheduler suspension count underflow (mismatched suspend/resume)");
+    }
+
+    --_state->_suspensionCount;
   }
 
-  --_state->_suspensionCount;
+  _state->_condition.notify_all();
 }
 
 void ThreadScheduler::shutdown ()
@@ -49,31 +89,426 @@ void ThreadScheduler::shutdown ()
   }
 
   _state->_condition.notify_all();
+  _state->_notFull.notify_all();
+}
+
+ThreadScheduler::Statistics ThreadScheduler::statistics () const noexcept
+{
+  Statistics statistics;
+  statistics.notifications = _state->_notifications.load(std::memory_order_relaxed);
+  statistics.notificationsAvoided = _state->_notificationsAvoided.load(std::memory_order_relaxed);
+  statistics.spinWakeups = _state->_spinWakeups.load(std::memory_order_relaxed);
+  statistics.parks = _state->_parks.load(std::memory_order_relaxed);
+  statistics.queued = _state->_size.load(std::memory_order_relaxed);
+  statistics.highWaterMark = _state->_highWaterMark.load(std::memory_order_relaxed);
+  statistics.blocked = _state->_blocked.load(std::memory_order_relaxed);
+  statistics.dropped = _state->_dropped.load(std::memory_order_relaxed);
+  statistics.rejected = _state->_rejected.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void ThreadScheduler::State::enqueue (SchedulingPriority priority, Task action)
+{
+  auto lane = static_cast<unsigned>(priority);
+  assert(lane < schedulingPriorityCount);
+
+  if (!admit()) {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  bool wasEmpty = _lanes[lane].push(std::move(action));
+
+  // The scheduler thread only parks after seeing every lane empty, so only
+  // the producer which makes one non-empty again needs to wake it up.
+  if (wasEmpty && _sleeping) {
+    {
+      // The scheduler thread sets _sleeping while holding the lock, so once
+      // we acquire it, the thread is guaranteed to be waiting on the
+      // condition.
+      std::lock_guard<std::mutex> guard(_mutex);
+    }
+
+    _condition.notify_one();
+    _notifications.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    _notificationsAvoided.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ThreadScheduler::State::enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action)
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+
+  if (_timers.push(deadline, std::move(action))) {
+    updateNextDeadline();
+
+    // The scheduler thread may be waiting for a later deadline.
+    if (_sleeping) {
+      _condition.notify_one();
+      _notifications.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool ThreadScheduler::State::admit ()
+{
+  const size_t capacity = _options.capacity;
+  size_t size = _size.load();
+
+  while (true) {
+    if (capacity == 0 || size < capacity) {
+      if (!_size.compare_exchange_weak(size, size + 1)) {
+        continue;
+      }
+
+      size++;
+      break;
+    }
+
+    switch (_options.overflowPolicy) {
+      case OverflowPolicy::Block:
+        if (currentScheduler == this || !_running) {
+          size = ++_size;
+          break;
+        }
+
+        {
+          std::unique_lock<std::mutex> guard(_mutex);
+
+          ++_blockedProducers;
+          _blocked.fetch_add(1, std::memory_order_relaxed);
+
+          // The scheduler thread decrements _size before checking
+          // _blockedProducers, so it will notify if this sees a full queue.
+          _notFull.wait(guard, [&] {
+            return _size < capacity || !_running;
+          });
+
+          --_blockedProducers;
+        }
+
+        size = _size.load();
+        continue;
+
+      case OverflowPolicy::DropNewest:
+        return false;
+
+      case OverflowPolicy::DropOldest:
+        if (size >= capacity * 2) {
+          return false;
+        }
+
+        size = ++_size;
+        ++_dropDebt;
+        break;
+
+      case OverflowPolicy::Reject:
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+        throw std::overflow_error("ThreadScheduler queue is full");
+    }
+
+    break;
+  }
+
+  size_t highWaterMark = _highWaterMark.load(std::memory_order_relaxed);
+  while (size > highWaterMark && !_highWaterMark.compare_exchange_weak(highWaterMark, size, std::memory_order_relaxed)) {
+  }
+
+  return true;
+}
+
+void ThreadScheduler::State::release () noexcept
+{
+  --_size;
+
+  if (_blockedProducers > 0) {
+    {
+      // Any producer which incremented _blockedProducers is either waiting,
+      // or will see the decremented size before it does.
+      std::lock_guard<std::mutex> guard(_mutex);
+    }
+
+    _notFull.notify_one();
+  }
+}
+
+bool ThreadScheduler::isCurrent () const noexcept
+{
+  return currentScheduler == _state.get();
+}
+
+bool ThreadScheduler::State::canRunInline () const noexcept
+{
+  if (currentScheduler != this || _suspensionCount > 0) {
+    return false;
+  }
+
+  // The action that's currently running still counts towards _size.
+  return _size == (_runningQueuedAction ? 1 : 0);
+}
+
+bool ThreadScheduler::State::lanesEmpty () const noexcept
+{
+  for (auto &lane : _lanes) {
+    if (!lane.empty()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ThreadScheduler::State::hasRunnableWork () const noexcept
+{
+  return !lanesEmpty() || std::chrono::steady_clock::now().time_since_epoch().count() >= _nextDeadline;
+}
+
+bool ThreadScheduler::State::spinForWork () const noexcept
+{
+  if (_options.spinDuration <= std::chrono::nanoseconds::zero()) {
+    return false;
+  }
+
+  auto spinUntil = std::chrono::steady_clock::now() + _options.spinDuration;
+
+  do {
+    if (hasRunnableWork()) {
+      return true;
+    }
+
+    // Let the scheduler thread park instead, where it will wait for these to
+    // change.
+    if (!_running || _suspensionCount > 0) {
+      return false;
+    }
+
+    std::this_thread::yield();
+  } while (std::chrono::steady_clock::now() < spinUntil);
+
+  return false;
+}
+
+void ThreadScheduler::State::updateNextDeadline () noexcept
+{
+  if (_timers.empty()) {
+    _nextDeadline = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+  } else {
+    _nextDeadline = _timers.nextDeadline().time_since_epoch().count();
+  }
 }
 
 void ThreadScheduler::detachedThreadMain (std::shared_ptr<State> state)
 {
+  using Clock = std::chrono::steady_clock;
+
+  currentScheduler = state.get();
+
+  // Reused for each batch of timers, to avoid allocating every time.
+  std::vector<Task> expired;
+
+  // Actions which have been taken from each lane, but not yet run. These
+  // persist across iterations if running them is interrupted.
+  TaskList actions[schedulingPriorityCount];
+
+  // How many actions have run from higher lanes while each lane was waiting.
+  unsigned skipped[schedulingPriorityCount] = {};
+
+  auto timerExpired = [&] {
+    return state->_nextDeadline != std::numeric_limits<Clock::rep>::max() && Clock::now().time_since_epoch().count() >= state->_nextDeadline;
+  };
+
+  auto takeActions = [&] {
+    bool any = false;
+
+    for (unsigned lane = 0; lane < schedulingPriorityCount; lane++) {
+      if (!state->_lanes[lane].empty()) {
+        actions[lane].append(state->_lanes[lane].popAll());
+      }
+
+      any = any || !actions[lane].empty();
+    }
+
+    return any;
+  };
+
+  // Picks the highest non-empty lane, unless a lower one has been starved.
+  auto nextLane = [&] {
+    unsigned highest = schedulingPriorityCount;
+
+    for (unsigned lane = 0; lane < schedulingPriorityCount; lane++) {
+      if (actions[lane].empty()) {
+        continue;
+      }
+
+      if (skipped[lane] >= state->_options.starvationLimit) {
+        return lane;
+      }
+
+      highest = lane;
+    }
+
+    return highest;
+  };
+
+  // Discards the oldest actions owed to OverflowPolicy::DropOldest,
+  // preferring the lowest priority lanes.
+  auto dropOldest = [&] {
+    size_t debt = state->_dropDebt.load();
+
+    while (debt > 0) {
+      auto it = std::find_if(std::begin(actions), std::end(actions), [](const TaskList &list) {
+        return !list.empty();
+      });
+
+      if (it == std::end(actions)) {
+        break;
+      }
+
+      if (state->_dropDebt.compare_exchange_weak(debt, debt - 1)) {
+        it->dropFront();
+        state->release();
+        state->_dropped.fetch_add(1, std::memory_order_relaxed);
+
+        debt--;
+      }
+    }
+  };
+
+  auto hasTakenActions = [&] {
+    for (auto &list : actions) {
+      if (!list.empty()) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
   while (true) {
-    decltype(state->_queue) actions;
-    std::unique_lock<std::mutex> guard(state->_mutex);
+    if (state->_suspensionCount == 0) {
+      bool ranActions = false;
+
+      if (timerExpired()) {
+        {
+          std::lock_guard<std::mutex> guard(state->_mutex);
+
+          state->_timers.popExpired(Clock::now(), expired);
+          state->updateNextDeadline();
+        }
+
+        for (auto &action : expired) {
+          action();
+
+          if (state->_options.yieldBetweenActions) {
+            std::this_thread::yield();
+          }
+        }
+
+        ranActions = !expired.empty();
+        expired.clear();
+      }
+
+      // Take newly queued actions before each one runs, so that higher
+      // priority work doesn't wait behind a batch of lower priority work.
+      while (takeActions()) {
+        dropOldest();
+
+        unsigned lane = nextLane();
+        if (lane == schedulingPriorityCount) {
+          continue;
+        }
+
+        for (unsigned lower = 0; lower < lane; lower++) {
+          if (!actions[lower].empty()) {
+            skipped[lower]++;
+          }
+        }
+
+        skipped[lane] = 0;
+        ranActions = true;
+
+        state->_runningQueuedAction = true;
+        actions[lane].runFront();
+        state->_runningQueuedAction = false;
+
+        state->release();
 
-    while (state->_queue.empty() || state->_suspensionCount > 0) {
-      state->_condition.wait(guard);
+        if (state->_options.yieldBetweenActions) {
+          std::this_thread::yield();
+        }
 
-      if (!state->_running) {
-        return;
+        if (state->_suspensionCount > 0 || timerExpired()) {
+          break;
+        }
+      }
+
+      if (ranActions) {
+        continue;
+      }
+
+      // Producers don't notify while we're spinning, so this avoids their
+      // syscalls as well as our own.
+      if (state->spinForWork()) {
+        state->_spinWakeups.fetch_add(1, std::memory_order_relaxed);
+        continue;
       }
     }
 
-    actions.swap(state->_queue);
-    guard.unlock();
+    std::unique_lock<std::mutex> guard(state->_mutex);
 
-    for (const auto &action : actions) {
-      action();
+    // This must be visible before the lanes are checked below, so that any
+    // producer which pushes after the check will see that it needs to notify.
+    state->_sleeping = true;
 
-      if (state->_yieldBetweenActions) {
-        std::this_thread::yield();
+    while (state->_running) {
+      if (state->_suspensionCount > 0) {
+        state->_parks.fetch_add(1, std::memory_order_relaxed);
+        state->_condition.wait(guard);
+      } else if (hasTakenActions() || !state->lanesEmpty()) {
+        break;
+      } else if (state->_timers.empty()) {
+        state->_parks.fetch_add(1, std::memory_order_relaxed);
+        state->_condition.wait(guard);
+      } else if (Clock::now() < state->_timers.nextDeadline()) {
+        state->_parks.fetch_add(1, std::memory_order_relaxed);
+        state->_condition.wait_until(guard, state->_timers.nextDeadline());
+      } else {
+        break;
       }
     }
+
+    state->_sleeping = false;
+
+    if (!state->_running) {
+      return;
+    }
   }
 }
+
+bool TrampolineScheduler::isTrampolining () noexcept
+{
+  return currentTrampoline()._running;
+}
+
+void TrampolineScheduler::run (Task action)
+{
+  Trampoline &trampoline = currentTrampoline();
+
+  if (trampoline._running) {
+    trampoline._queue.push_back(std::move(action));
+    return;
+  }
+
+  trampoline._running = true;
+  action();
+
+  while (!trampoline._queue.empty()) {
+    Task next = std::move(trampoline._queue.front());
+    trampoline._queue.pop_front();
+
+    next();
+  }
+
+  trampoline._running = false;
+}
@@ -10,16 +10,20 @@
 #ifndef FB_SINKLINE_SCHEDULER_H
 #define FB_SINKLINE_SCHEDULER_H
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <limits>
 #include <memory>
 #include <stdexcept>
 #include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #if __has_include(<dispatch/dispatch.h>)
@@ -28,6 +32,12 @@
 #endif
 
 #include "PlatformSupport.h"
+#include "SchedulingPriority.h"
+#include "Task.h"
+#include "TaskQueue.h"
+#include "ThreadPlacement.h"
+#include "TimerQueue.h"
+#include "TupleExt.h"
 
 namespace fb { namespace sinkline {
 
@@ -54,6 +64,62 @@ void runPromisedAction (std::promise<R> &promise, F &&action, Args &&...args)
   }
 }
 
+/// Runs an action whose result will never be observed.
+///
+/// Any exception thrown by the action is discarded, just as it would be if it
+/// were stored into a std::future that nobody waits upon.
+template<typename F, typename... Args>
+void runDiscardedAction (F &&action, Args &&...args) noexcept
+{
+  try {
+    std::forward<F>(action)(std::forward<Args>(args)...);
+  } catch (...) {
+  }
+}
+
+/// The result of an action scheduled with the given arguments, once both have
+/// been moved into the scheduler.
+template<typename F, typename... Args>
+using ScheduledResult = std::result_of_t<std::decay_t<F>(std::decay_t<Args>...)>;
+
+/// Stores an action and its arguments, so that the action can be invoked
+/// later (e.g., upon another thread).
+///
+/// The call operator moves the arguments into the action, so it must only be
+/// invoked once.
+template<typename F, typename... Args>
+struct DeferredCall final
+{
+  public:
+    DeferredCall () = delete;
+
+    template<typename Action, typename... Inputs>
+    explicit DeferredCall (Action &&action, Inputs &&...inputs)
+      : _action(std::forward<Action>(action))
+      , _arguments(std::forward<Inputs>(inputs)...)
+    {}
+
+    DeferredCall (DeferredCall &&) = default;
+    DeferredCall &operator= (DeferredCall &&) = default;
+
+    auto operator() ()
+    {
+      return callWithTuple(std::move(_action), std::move(_arguments));
+    }
+
+  private:
+    F _action;
+    std::tuple<Args...> _arguments;
+};
+
+/// Creates a DeferredCall by forwarding (moving or copying, as appropriate)
+/// the given action and arguments into it.
+template<typename F, typename... Args>
+auto deferCall (F &&action, Args &&...args)
+{
+  return DeferredCall<std::decay_t<F>, std::decay_t<Args>...>(std::forward<F>(action), std::forward<Args>(args)...);
+}
+
 /// Implements the behavior of reschedule() for different callable objects.
 template<typename Scheduler, typename Callable>
 struct RescheduleHelper final : public RescheduleHelper<Scheduler, decltype(&Callable::operator())>
@@ -71,7 +137,21 @@ struct RescheduleHelper<Scheduler, Result (Callable::*)(Arguments...)>
     static auto reschedule (Scheduler scheduler, Callable fn)
     {
       return [scheduler, fn = std::move(fn)](Arguments ...arguments) {
-        scheduler->schedule(fn, arguments...);
+        scheduler->post(fn, std::forward<Arguments>(arguments)...);
+      };
+    }
+};
+
+template<typename Scheduler, typename Callable, typename Result, typename... Arguments>
+struct RescheduleHelper<Scheduler, Result (Callable::*)(Arguments...) const>
+{
+  public:
+    RescheduleHelper () = delete;
+
+    static auto reschedule (Scheduler scheduler, Callable fn)
+    {
+      return [scheduler, fn = std::move(fn)](Arguments ...arguments) {
+        scheduler->post(fn, std::forward<Arguments>(arguments)...);
       };
     }
 };
@@ -85,7 +165,7 @@ struct RescheduleHelper<Scheduler, Result (*)(Arguments...)> final
     static auto reschedule (Scheduler scheduler, Result (*fn)(Arguments...))
     {
       return [scheduler, fn](Arguments ...arguments) {
-        scheduler->schedule(fn, arguments...);
+        scheduler->post(fn, std::forward<Arguments>(arguments)...);
       };
     }
 };
@@ -101,7 +181,7 @@ struct RescheduleHelper<Scheduler, Result (^)(Arguments...)> final
     static auto reschedule (Scheduler scheduler, Result (^block)(Arguments...))
     {
       return ^(Arguments ...arguments) {
-        scheduler->schedule(block, arguments...);
+        scheduler->post(block, std::forward<Arguments>(arguments)...);
       };
     }
 };
@@ -123,8 +203,103 @@ auto reschedule (Scheduler scheduler, Callable &&fn)
 class ThreadScheduler final
 {
   public:
+    /// What to do when an action is scheduled while the queue is already at
+    /// its capacity.
+    enum class OverflowPolicy
+    {
+      /// Blocks the scheduling thread until there is room. Actions scheduled
+      /// from the scheduler thread itself are always accepted, since blocking
+      /// it would deadlock.
+      Block,
+
+      /// Discards the new action. If it was scheduled with schedule(), its
+      /// future will report std::future_errc::broken_promise.
+      DropNewest,
+
+      /// Accepts the new action, and has the scheduler thread discard the
+      /// oldest action in the lowest priority lane to make up for it. If the
+      /// scheduler thread falls so far behind that the queue reaches twice its
+      /// capacity, new actions are dropped instead.
+      DropOldest,
+
+      /// Throws std::overflow_error from schedule() or post().
+      Reject,
+    };
+
+    /// Tunes how the scheduler thread waits for work.
+    struct Options final
+    {
+      /// Whether the scheduler thread should yield after running each action.
+      bool yieldBetweenActions = false;
+
+      /// How long the scheduler thread should keep polling for new work, once
+      /// it runs out, before it parks on a condition variable.
+      ///
+      /// While polling, producers don't need to lock or notify anything, and
+      /// new work is picked up without the latency of a wakeup. This costs CPU
+      /// time, so it is disabled by default.
+      std::chrono::nanoseconds spinDuration = std::chrono::nanoseconds::zero();
+
+      /// Where the scheduler thread should run. By default, it can run
+      /// anywhere.
+      ThreadPlacement placement;
+
+      /// The most actions that can run from higher priority lanes while a
+      /// lower priority action is waiting. Once this many have been run, the
+      /// oldest action from the starved lane runs next.
+      unsigned starvationLimit = 32;
+
+      /// The most actions that can be queued (across all lanes) before
+      /// `overflowPolicy` applies, or zero for no limit. Timers do not count
+      /// against the capacity.
+      size_t capacity = 0;
+
+      OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+    };
+
+    /// Counters describing how often the scheduler thread had to be woken up.
+    /// These are updated without synchronization, so they are only
+    /// approximate while actions are being scheduled.
+    struct Statistics final
+    {
+      /// Actions or timers which required a producer to wake up the scheduler
+      /// thread.
+      uint64_t notifications;
+
+      /// Actions which did not require a producer to notify, because the
+      /// scheduler thread was already awake (or spinning), or other work was
+      /// already queued ahead of them.
+      uint64_t notificationsAvoided;
+
+      /// How many times the scheduler thread found new work while spinning,
+      /// instead of parking.
+      uint64_t spinWakeups;
+
+      /// How many times the scheduler thread parked on its condition variable.
+      uint64_t parks;
+
+      /// The number of actions which are currently queued.
+      size_t queued;
+
+      /// The most actions that have ever been queued at once.
+      size_t highWaterMark;
+
+      /// How many times a producer had to block because the queue was full.
+      uint64_t blocked;
+
+      /// Actions which were discarded because the queue was full.
+      uint64_t dropped;
+
+      /// Actions which were rejected because the queue was full.
+      uint64_t rejected;
+    };
+
     ThreadScheduler (bool yieldBetweenActions = false);
 
+    /// Throws std::system_error if the scheduler thread cannot be pinned to
+    /// the requested placement.
+    explicit ThreadScheduler (const Options &options);
+
     ThreadScheduler (const ThreadScheduler &) = delete;
     ThreadScheduler &operator= (const ThreadScheduler &) = delete;
 
@@ -138,21 +313,82 @@ class ThreadScheduler final
       }
     }
 
+    /// Schedules an action with SchedulingPriority::Normal.
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      return schedule(SchedulingPriority::Normal, std::forward<F>(action), std::forward<Args>(args)...);
+    }
+
+    /// Schedules an action in the lane for the given priority.
+    ///
+    /// Actions in the same lane run in the order they were scheduled, but
+    /// actions in higher lanes will run ahead of any in lower lanes (subject
+    /// to Options::starvationLimit).
+    ///
+    /// If the scheduler has a capacity, and it's been reached, this behaves
+    /// according to Options::overflowPolicy.
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (SchedulingPriority priority, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      _state->enqueue(priority, [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// Like schedule(), but discards the result of the action instead of
+    /// creating a std::future for it.
     template<typename F, typename ...Args>
-    std::future<std::result_of_t<F(Args...)>> schedule (F action, Args ...args)
+    void post (F &&action, Args &&...args)
     {
-      auto promise = std::make_shared<std::promise<void>>();
+      post(SchedulingPriority::Normal, std::forward<F>(action), std::forward<Args>(args)...);
+    }
 
-      {
-        std::lock_guard<std::mutex> guard(_state->_mutex);
+    template<typename F, typename ...Args>
+    void post (SchedulingPriority priority, F &&action, Args &&...args)
+    {
+      _state->enqueue(priority, [call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
 
-        _state->_queue.push_back([promise, action = std::move(action), args...] {
-          runPromisedAction(*promise, action, args...);
-        });
+    /// Like post(), but runs the action immediately if this is called from
+    /// the scheduler thread, and nothing else is waiting to run ahead of it.
+    /// Otherwise, the action is queued with SchedulingPriority::Normal.
+    template<typename F, typename ...Args>
+    void dispatch (F &&action, Args &&...args)
+    {
+      if (_state->canRunInline()) {
+        runDiscardedAction(std::forward<F>(action), std::forward<Args>(args)...);
+      } else {
+        post(std::forward<F>(action), std::forward<Args>(args)...);
       }
+    }
+
+    /// Whether the calling thread is this scheduler's thread.
+    bool isCurrent () const noexcept;
+
+    /// Like schedule(), but waits until the given time before running the
+    /// action.
+    ///
+    /// Pending timers are kept in a heap on the scheduler, and are run by the
+    /// scheduler thread itself, ahead of any other lanes.
+    template<typename Clock, typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      _state->enqueueAfter(toSteadyTimePoint(timePoint), [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
 
-      _state->_condition.notify_all();
-      return promise->get_future();
+      return future;
     }
 
     void suspend ();
@@ -160,22 +396,110 @@ class ThreadScheduler final
 
     void shutdown ();
 
+    Statistics statistics () const noexcept;
+
   private:
     struct State {
       std::mutex _mutex;
       std::condition_variable _condition;
-      const bool _yieldBetweenActions;
-
-      // These fields must be synchronized on _mutex.
-      std::vector<std::function<void()>> _queue;
-      bool _running;
-      unsigned _suspensionCount;
-
-      State (bool yieldBetweenActions)
-        : _yieldBetweenActions(yieldBetweenActions)
+      const Options _options;
+
+      // One queue per SchedulingPriority. Producers push onto these without
+      // locking, and only the scheduler thread pops from them.
+      TaskQueue _lanes[schedulingPriorityCount];
+
+      // Set by the scheduler thread (while holding _mutex) just before it
+      // waits on _condition, so that producers only need to lock and notify
+      // when it might actually be asleep.
+      std::atomic<bool> _sleeping;
+
+      // These fields must only be modified while holding _mutex.
+      std::atomic<bool> _running;
+      std::atomic<unsigned> _suspensionCount;
+
+      // The deadline of the earliest timer, in steady_clock ticks (or the
+      // maximum value, if there are no timers). This lets the scheduler thread
+      // check for expired timers without locking.
+      std::atomic<std::chrono::steady_clock::rep> _nextDeadline;
+
+      // Must be synchronized on _mutex.
+      TimerQueue<> _timers;
+
+      // See Statistics. These are only ever accessed with relaxed ordering.
+      std::atomic<uint64_t> _notifications;
+      std::atomic<uint64_t> _notificationsAvoided;
+      std::atomic<uint64_t> _spinWakeups;
+      std::atomic<uint64_t> _parks;
+      std::atomic<size_t> _highWaterMark;
+      std::atomic<uint64_t> _blocked;
+      std::atomic<uint64_t> _dropped;
+      std::atomic<uint64_t> _rejected;
+
+      // The number of actions which have been admitted to the lanes, but not
+      // yet run or discarded.
+      std::atomic<size_t> _size;
+
+      // The number of producers waiting on _notFull. This must only be
+      // incremented while holding _mutex.
+      std::condition_variable _notFull;
+      std::atomic<unsigned> _blockedProducers;
+
+      // How many of the oldest actions the scheduler thread should discard,
+      // for OverflowPolicy::DropOldest.
+      std::atomic<size_t> _dropDebt;
+
+      // Whether the scheduler thread is running an action from the lanes
+      // (which is still counted in _size), rather than a timer. Only accessed
+      // by the scheduler thread.
+      bool _runningQueuedAction;
+
+      State (const Options &options)
+        : _options(options)
+        , _sleeping(false)
         , _running(true)
         , _suspensionCount(0)
+        , _nextDeadline(std::numeric_limits<std::chrono::steady_clock::rep>::max())
+        , _notifications(0)
+        , _notificationsAvoided(0)
+        , _spinWakeups(0)
+        , _parks(0)
+        , _highWaterMark(0)
+        , _blocked(0)
+        , _dropped(0)
+        , _rejected(0)
+        , _size(0)
+        , _blockedProducers(0)
+        , _dropDebt(0)
+        , _runningQueuedAction(false)
       {}
+
+      void enqueue (SchedulingPriority priority, Task action);
+      void enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action);
+
+      // Accounts for a new action, applying the overflow policy if the
+      // capacity has been reached. Returns whether the action should be
+      // enqueued.
+      bool admit ();
+
+      // Accounts for an action which has been run or discarded by the
+      // scheduler thread.
+      void release () noexcept;
+
+      bool lanesEmpty () const noexcept;
+
+      // Whether the calling thread is the scheduler thread, and no other
+      // actions are queued, so one can run immediately without reordering.
+      bool canRunInline () const noexcept;
+
+      // Whether the scheduler thread has anything it could run right now.
+      bool hasRunnableWork () const noexcept;
+
+      // Polls for runnable work for up to _options.spinDuration, returning
+      // whether any was found.
+      bool spinForWork () const noexcept;
+
+      // Must be called while holding _mutex.
+      void updateNextDeadline () noexcept;
     };
 
     std::thread _thread;
@@ -188,15 +512,84 @@ class ThreadScheduler final
 struct ImmediateScheduler final
 {
   public:
+    /// Unlike other schedulers, the arguments are passed to the action as
+    /// given, without being moved into the scheduler first.
     template<typename F, typename ...Args>
-    std::future<std::result_of_t<F(Args...)>> schedule (F &&action, Args &&...args)
+    std::future<std::result_of_t<F &&(Args &&...)>> schedule (F &&action, Args &&...args)
     {
-      std::promise<std::result_of_t<F(Args...)>> promise;
+      std::promise<std::result_of_t<F &&(Args &&...)>> promise;
 
       runPromisedAction(promise, std::forward<F>(action), std::forward<Args>(args)...);
 
       return promise.get_future();
     }
+
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      runDiscardedAction(std::forward<F>(action), std::forward<Args>(args)...);
+    }
+
+    template<typename F, typename ...Args>
+    void dispatch (F &&action, Args &&...args)
+    {
+      post(std::forward<F>(action), std::forward<Args>(args)...);
+    }
+
+    /// Always true, since actions run on whichever thread schedules them.
+    bool isCurrent () const noexcept
+    {
+      return true;
+    }
+};
+
+/// Runs actions upon the current thread, like ImmediateScheduler, but without
+/// letting them recurse.
+///
+/// The first action scheduled on a thread runs immediately. Any actions that it
+/// schedules (directly, or through sinks which it invokes) are queued on that
+/// thread instead, and run in order once it returns. Deep chains of
+/// synchronously-completing callbacks therefore become a loop, with bounded
+/// stack depth and no thread hop.
+///
+/// All TrampolineSchedulers on a thread share the same queue. Since a nested
+/// action only runs once the outermost one returns, its std::future must not be
+/// waited upon from within an action (or it will deadlock).
+struct TrampolineScheduler final
+{
+  public:
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      run([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      run([call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
+
+    /// Whether the current thread is running an action from a
+    /// TrampolineScheduler.
+    static bool isTrampolining () noexcept;
+
+    bool isCurrent () const noexcept
+    {
+      return isTrampolining();
+    }
+
+  private:
+    static void run (Task action);
 };
 
 #if DISPATCH_API_VERSION
@@ -210,6 +603,8 @@ class GCDScheduler final
       if (targetQueue) {
         dispatch_set_target_queue(_queue, targetQueue);
       }
+
+      dispatch_queue_set_specific(_queue, queueKey(), _queue, NULL);
     }
 
     GCDScheduler (const GCDScheduler &) = delete;
@@ -224,32 +619,42 @@ class GCDScheduler final
     }
 
     template<typename F, typename ...Args>
-    std::future<std::result_of_t<F(Args...)>> schedule (F action, Args ...args)
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
     {
-      auto promise = std::make_shared<std::promise<std::result_of_t<F(Args...)>>>();
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
 
-      dispatch_async(_queue, ^{
-        runPromisedAction(*promise, action, args...);
-      });
+      dispatch_async_f(_queue, new Task([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      }), &runTask);
 
-      return promise->get_future();
+      return future;
+    }
+
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      dispatch_async_f(_queue, new Task([call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      }), &runTask);
     }
 
     template<typename Clock, typename F, typename ...Args>
-    std::future<std::result_of_t<F(Args...)>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F action, Args ...args)
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F &&action, Args &&...args)
     {
-      auto promise = std::make_shared<std::promise<std::result_of_t<F(Args...)>>>();
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
 
-      dispatch_block_t actionBlock = ^{
-        runPromisedAction(*promise, action, args...);
-      };
+      auto task = new Task([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
 
       if (Clock::is_steady) {
         auto now = Clock::now();
         auto nsDelta = std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint - now);
 
         dispatch_time_t dsTime = dispatch_time(DISPATCH_TIME_NOW, nsDelta.count());
-        dispatch_after(dsTime, _queue, actionBlock);
+        dispatch_after_f(dsTime, _queue, task, &runTask);
       } else {
         auto epochDuration = timePoint.time_since_epoch();
 
@@ -262,10 +667,17 @@ class GCDScheduler final
         ts.tv_nsec = ns.count();
 
         dispatch_time_t dsTime = dispatch_walltime(&ts, 0);
-        dispatch_after(dsTime, _queue, actionBlock);
+        dispatch_after_f(dsTime, _queue, task, &runTask);
       }
 
-      return promise->get_future();
+      return future;
+    }
+
+    /// Whether the calling thread is running a block from this scheduler's
+    /// queue (or from a queue targeting it).
+    bool isCurrent () const noexcept
+    {
+      return dispatch_get_specific(queueKey()) == _queue;
     }
 
     void suspend () noexcept
@@ -280,6 +692,23 @@ class GCDScheduler final
 
   private:
     dispatch_queue_t _queue;
+
+    /// The key under which each queue is associated with itself, so that
+    /// isCurrent() can identify it.
+    static const void *queueKey () noexcept
+    {
+      static const char key = 0;
+      return &key;
+    }
+
+    /// The function used to invoke tasks submitted to _queue. Since blocks
+    /// can only copy their captures, actions are instead moved into a Task,
+    /// which this function takes ownership of.
+    static void runTask (void *context)
+    {
+      std::unique_ptr<Task> task(static_cast<Task *>(context));
+      (*task)();
+    }
 };
 
 #endif
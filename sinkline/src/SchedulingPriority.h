@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_SCHEDULING_PRIORITY_H
+#define FB_SINKLINE_SCHEDULING_PRIORITY_H
+
+namespace fb { namespace sinkline {
+
+/// The lanes that a prioritizing scheduler (like ThreadScheduler) can queue
+/// actions into. Higher lanes are served first.
+enum class SchedulingPriority : unsigned
+{
+  Low,
+  Normal,
+  High,
+};
+
+/// The number of SchedulingPriority lanes.
+constexpr unsigned schedulingPriorityCount = 3;
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,250 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_STRAND_SCHEDULER_H
+#define FB_SINKLINE_STRAND_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <utility>
+
+#include "Scheduler.h"
+#include "Task.h"
+#include "TaskQueue.h"
+#include "ThreadPoolScheduler.h"
+#include "TimerQueue.h"
+
+namespace fb { namespace sinkline {
+
+/// Runs actions one at a time, in the order they were scheduled, upon
+/// another (usually concurrent) scheduler.
+///
+/// A strand doesn't own any threads. Instead, whenever it has pending
+/// actions, exactly one drain action is posted to the target scheduler, which
+/// runs a batch of them and then re-posts itself if more are waiting. This
+/// makes strands cheap enough to have one per pipeline, all sharing one
+/// ThreadPoolScheduler, while still guaranteeing that a strand's actions never
+/// overlap.
+///
+/// If the target is bounded, and drops or rejects the drain action, the
+/// strand's actions stay queued until the next action is scheduled upon it.
+/// In particular, an action whose schedule() or post() threw because the
+/// target rejected the drain will still run then.
+template<typename Scheduler = ThreadPoolScheduler>
+class StrandScheduler final
+{
+  public:
+    using target_type = std::shared_ptr<Scheduler>;
+
+    StrandScheduler () = delete;
+
+    explicit StrandScheduler (target_type target)
+      : _target(std::move(target))
+      , _state(std::make_shared<State>())
+    {}
+
+    StrandScheduler (const StrandScheduler &) = delete;
+    StrandScheduler &operator= (const StrandScheduler &) = delete;
+
+    StrandScheduler (StrandScheduler &&) = default;
+    StrandScheduler &operator= (StrandScheduler &&) = default;
+
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      enqueue(_state, _target, [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// Like schedule(), but discards the result of the action instead of
+    /// creating a std::future for it.
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      enqueue(_state, _target, [call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
+
+    /// Like post(), but runs the action immediately if this is called from
+    /// one of this strand's actions, and nothing else is waiting in the
+    /// strand.
+    template<typename F, typename ...Args>
+    void dispatch (F &&action, Args &&...args)
+    {
+      if (isCurrent() && _state->_count == _state->_batchRan + 1) {
+        runDiscardedAction(std::forward<F>(action), std::forward<Args>(args)...);
+      } else {
+        post(std::forward<F>(action), std::forward<Args>(args)...);
+      }
+    }
+
+    /// Whether the calling thread is running one of this strand's actions.
+    bool isCurrent () const noexcept
+    {
+      return currentStrand() == _state.get();
+    }
+
+    /// Like schedule(), but waits until the given time before running the
+    /// action.
+    ///
+    /// The target scheduler keeps the timer, and the action joins the end of
+    /// the strand once it expires.
+    template<typename Clock, typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      Task task([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      _target->scheduleAfter(timePoint, [state = _state, target = _target, task = std::move(task)]() mutable {
+        enqueue(state, target, std::move(task));
+      });
+
+      return future;
+    }
+
+    /// The scheduler that this strand runs its actions upon.
+    const target_type &target () const noexcept
+    {
+      return _target;
+    }
+
+  private:
+    struct State {
+      TaskQueue _queue;
+
+      // The number of actions which have been scheduled, but not yet run.
+      std::atomic<size_t> _count;
+
+      // Whether a drain action has been posted to the target, and hasn't yet
+      // finished (or been dropped). Whoever sets this is responsible for
+      // posting the drain.
+      std::atomic<bool> _drainPosted;
+
+      // How many actions the current drain has finished running. Only
+      // accessed from within the drain.
+      size_t _batchRan;
+
+      State () noexcept
+        : _count(0)
+        , _drainPosted(false)
+        , _batchRan(0)
+      {}
+    };
+
+    /// The action posted to the target to run a batch of the strand's actions.
+    ///
+    /// If the target drops this without running it (e.g., because it's a
+    /// bounded ThreadScheduler), or throws from post(), the destructor gives
+    /// up the claim on _drainPosted. The strand's actions stay queued, and
+    /// the next one scheduled will post a new drain.
+    struct Drain final
+    {
+      std::shared_ptr<State> _state;
+      target_type _target;
+
+      Drain (std::shared_ptr<State> state, target_type target) noexcept
+        : _state(std::move(state))
+        , _target(std::move(target))
+      {}
+
+      Drain (Drain &&) noexcept = default;
+      Drain &operator= (Drain &&) noexcept = default;
+
+      ~Drain ()
+      {
+        if (_state) {
+          _state->_drainPosted = false;
+        }
+      }
+
+      void operator() ()
+      {
+        // Once run, the destructor has nothing left to do.
+        auto state = std::move(_state);
+        drain(state, _target);
+      }
+    };
+
+    target_type _target;
+    std::shared_ptr<State> _state;
+
+    static void enqueue (const std::shared_ptr<State> &state, const target_type &target, Task action)
+    {
+      // This must be counted before it's pushed, so that a drain which has
+      // already started can't run (and uncount) it first.
+      state->_count.fetch_add(1);
+      state->_queue.push(std::move(action));
+
+      postDrainIfNeeded(state, target);
+    }
+
+    // Posts a drain, unless one is already posted. Its action is then
+    // guaranteed to run, because the drain re-checks the queue after giving
+    // up its claim.
+    static void postDrainIfNeeded (const std::shared_ptr<State> &state, const target_type &target)
+    {
+      if (!state->_drainPosted.exchange(true)) {
+        target->post(Drain(state, target));
+      }
+    }
+
+    // The strand whose actions are running on the current thread, if any.
+    static const State *&currentStrand () noexcept
+    {
+      static thread_local const State *current = nullptr;
+      return current;
+    }
+
+    static void drain (const std::shared_ptr<State> &state, const target_type &target)
+    {
+      TaskList actions = state->_queue.popAll();
+      size_t ran = 0;
+
+      const State *previous = currentStrand();
+      currentStrand() = state.get();
+
+      while (!actions.empty()) {
+        state->_batchRan = ran;
+        actions.runFront();
+        ran++;
+      }
+
+      currentStrand() = previous;
+      state->_count.fetch_sub(ran);
+
+      // Rather than looping here until the strand is empty, give up the claim
+      // and post again, so that one busy strand can't monopolize a worker.
+      //
+      // Only actions that have actually been pushed need a drain. A producer
+      // which has counted an action, but not pushed it yet, will post one
+      // itself once it has.
+      state->_drainPosted = false;
+
+      if (!state->_queue.empty()) {
+        postDrainIfNeeded(state, target);
+      }
+    }
+};
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_TASK_H
+#define FB_SINKLINE_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace fb { namespace sinkline {
+
+/// A move-only, type-erased callable object with no arguments and no result,
+/// used to hold actions in scheduler queues.
+///
+/// Unlike std::function, the wrapped callable does not need to be copyable.
+/// Callables which fit into `InlineSize` bytes (and can be moved without
+/// throwing) are stored inline, without allocating.
+template<std::size_t InlineSize>
+class BasicTask final
+{
+  public:
+    static constexpr std::size_t inline_size = InlineSize;
+
+    BasicTask () noexcept
+      : _operations(nullptr)
+    {}
+
+    template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, BasicTask>::value>>
+    BasicTask (Callable &&fn)
+      : _operations(&Operations<std::decay_t<Callable>>::table)
+    {
+      Operations<std::decay_t<Callable>>::construct(&_storage, std::forward<Callable>(fn));
+    }
+
+    BasicTask (const BasicTask &) = delete;
+    BasicTask &operator= (const BasicTask &) = delete;
+
+    BasicTask (BasicTask &&other) noexcept
+      : _operations(other._operations)
+    {
+      if (_operations) {
+        _operations->move(&other._storage, &_storage);
+        other._operations = nullptr;
+      }
+    }
+
+    BasicTask &operator= (BasicTask &&other) noexcept
+    {
+      if (&other != this) {
+        reset();
+
+        if ((_operations = other._operations)) {
+          _operations->move(&other._storage, &_storage);
+          other._operations = nullptr;
+        }
+      }
+
+      return *this;
+    }
+
+    ~BasicTask ()
+    {
+      reset();
+    }
+
+    explicit operator bool () const noexcept
+    {
+      return _operations != nullptr;
+    }
+
+    /// Invokes the wrapped callable. It is an error to call this on an empty
+    /// task.
+    void operator() ()
+    {
+      _operations->invoke(&_storage);
+    }
+
+    /// Destroys the wrapped callable, leaving this task empty.
+    void reset () noexcept
+    {
+      if (_operations) {
+        _operations->destroy(&_storage);
+        _operations = nullptr;
+      }
+    }
+
+  private:
+    using storage_type = std::aligned_storage_t<InlineSize, alignof(std::max_align_t)>;
+
+    struct OperationTable {
+      void (*invoke)(storage_type *storage);
+      void (*move)(storage_type *from, storage_type *to) noexcept;
+      void (*destroy)(storage_type *storage) noexcept;
+    };
+
+    template<typename Callable>
+    struct IsInline final : public std::integral_constant<bool,
+      sizeof(Callable) <= sizeof(storage_type)
+      && alignof(storage_type) % alignof(Callable) == 0
+      && std::is_nothrow_move_constructible<Callable>::value>
+    {};
+
+    /// Implements the operation table for callables stored inline.
+    template<typename Callable, bool Inline = IsInline<Callable>::value>
+    struct Operations final
+    {
+      template<typename Source>
+      static void construct (storage_type *storage, Source &&fn)
+      {
+        new(storage) Callable(std::forward<Source>(fn));
+      }
+
+      static Callable &get (storage_type *storage) noexcept
+      {
+        return *reinterpret_cast<Callable *>(storage);
+      }
+
+      static void invoke (storage_type *storage)
+      {
+        get(storage)();
+      }
+
+      static void move (storage_type *from, storage_type *to) noexcept
+      {
+        new(to) Callable(std::move(get(from)));
+        get(from).~Callable();
+      }
+
+      static void destroy (storage_type *storage) noexcept
+      {
+        get(storage).~Callable();
+      }
+
+      static constexpr OperationTable table = {&invoke, &move, &destroy};
+    };
+
+    /// Implements the operation table for callables which are too large (or
+    /// unsafe) to store inline, by storing a pointer to them instead.
+    template<typename Callable>
+    struct Operations<Callable, false> final
+    {
+      template<typename Source>
+      static void construct (storage_type *storage, Source &&fn)
+      {
+        new(storage) Callable *(new Callable(std::forward<Source>(fn)));
+      }
+
+      static Callable *&get (storage_type *storage) noexcept
+      {
+        return *reinterpret_cast<Callable **>(storage);
+      }
+
+      static void invoke (storage_type *storage)
+      {
+        (*get(storage))();
+      }
+
+      static void move (storage_type *from, storage_type *to) noexcept
+      {
+        new(to) Callable *(get(from));
+      }
+
+      static void destroy (storage_type *storage) noexcept
+      {
+        delete get(storage);
+      }
+
+      static constexpr OperationTable table = {&invoke, &move, &destroy};
+    };
+
+    storage_type _storage;
+    const OperationTable *_operations;
+};
+
+template<std::size_t InlineSize>
+template<typename Callable, bool Inline>
+constexpr typename BasicTask<InlineSize>::OperationTable BasicTask<InlineSize>::Operations<Callable, Inline>::table;
+
+template<std::size_t InlineSize>
+template<typename Callable>
+constexpr typename BasicTask<InlineSize>::OperationTable BasicTask<InlineSize>::Operations<Callable, false>::table;
+
+/// The task type used by the schedulers, which is large enough to hold a
+/// typical sinkline continuation and its arguments without allocating.
+using Task = BasicTask<64>;
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "TaskQueue.h"
+
+#include <vector>
+
+#include "PlatformSupport.h"
+
+#if __has_include(<sched.h>)
+#include <sched.h>
+#endif
+
+#if __has_include(<sys/syscall.h>)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace fb::sinkline;
+
+namespace {
+
+// The most queue nodes that any one thread will keep around for reuse.
+constexpr size_t maxCachedNodes = 256;
+
+// The number of separate recycling lists. NUMA nodes beyond this share lists.
+constexpr unsigned maxNumaNodes = 8;
+
+// The NUMA node which the calling thread is currently running upon, or 0 if
+// that can't be determined.
+unsigned currentNumaNode () noexcept
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+  // Usually implemented without entering the kernel.
+  unsigned cpu = 0, node = 0;
+  if (getcpu(&cpu, &node) == 0) {
+    return node;
+  }
+#elif defined(SYS_getcpu)
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif
+
+  return 0;
+}
+
+}
+
+MPSCQueue<QueuedTask> &QueuedTask::recycledNodes (unsigned numaNode) noexcept
+{
+  struct alignas(64) RecycledList final
+  {
+    MPSCQueue<QueuedTask> _nodes;
+  };
+
+  static RecycledList recycled[maxNumaNodes];
+  return recycled[numaNode % maxNumaNodes]._nodes;
+}
+
+QueuedTask *QueuedTask::create (Task task)
+{
+  // Nodes claimed from recycledNodes() by the current (producer) thread.
+  struct Cache final
+  {
+    std::vector<QueuedTask *> _nodes;
+
+    ~Cache ()
+    {
+      for (auto node : _nodes) {
+        delete node;
+      }
+    }
+  };
+
+  static thread_local Cache cache;
+  auto &cached = cache._nodes;
+
+  if (cached.empty()) {
+    // Only checked when the cache runs dry, so a thread which migrates to
+    // another NUMA node may briefly keep using nodes from the previous one.
+    unsigned numaNode = currentNumaNode();
+
+    // Claim everything that's been recycled since we last looked, rather than
+    // contending on the shared list for every task.
+    QueuedTask *recycled = recycledNodes(numaNode).popAll();
+
+    while (recycled) {
+      QueuedTask *next = recycled->_queueNext;
+
+      if (cached.size() < maxCachedNodes) {
+        cached.push_back(recycled);
+      } else {
+        delete recycled;
+      }
+
+      recycled = next;
+    }
+
+    if (cached.empty()) {
+      return new QueuedTask(std::move(task), numaNode);
+    }
+  }
+
+  QueuedTask *node = cached.back();
+  cached.pop_back();
+
+  node->_task = std::move(task);
+  return node;
+}
+
+void QueuedTask::recycle (QueuedTask *node) noexcept
+{
+  node->_task.reset();
+  recycledNodes(node->_homeNode).push(node);
+}
+
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_TASK_QUEUE_H
+#define FB_SINKLINE_TASK_QUEUE_H
+
+#include <utility>
+
+#include "MPSCQueue.h"
+#include "Task.h"
+
+namespace fb { namespace sinkline {
+
+/// A node which holds a Task in a TaskQueue.
+///
+/// Nodes are recycled instead of being freed: consumers return finished nodes
+/// to a shared lock-free list, and producers claim that whole list into a
+/// small thread-local cache. A steady stream of tasks therefore doesn't
+/// allocate.
+///
+/// Each node remembers the NUMA node of the thread which allocated it (and so
+/// usually first touched its memory), and is only recycled for producers
+/// running on that same NUMA node. Nodes therefore don't migrate between NUMA
+/// nodes, even when consumers are pinned elsewhere.
+struct QueuedTask final : public MPSCQueueHook<QueuedTask>
+{
+  public:
+    Task _task;
+
+    QueuedTask (Task task, unsigned homeNode) noexcept
+      : _task(std::move(task))
+      , _homeNode(homeNode)
+    {}
+
+    /// Returns a node holding the given task, reusing a recycled node if one
+    /// is available.
+    static QueuedTask *create (Task task);
+
+    /// Destroys the node's task, and makes the node available for reuse by
+    /// create().
+    static void recycle (QueuedTask *node) noexcept;
+
+  private:
+    /// The NUMA node whose recycled nodes this should return to.
+    unsigned _homeNode;
+
+    /// Nodes from the given NUMA node which have been recycled by any
+    /// consumer, but not yet claimed by a producer.
+    static MPSCQueue<QueuedTask> &recycledNodes (unsigned numaNode) noexcept;
+};
+
+/// A FIFO list of tasks which have been removed from a TaskQueue. This is only
+/// meant to be used by the queue's consumer.
+class TaskList final
+{
+  public:
+    TaskList () noexcept
+      : _head(nullptr)
+      , _tail(nullptr)
+    {}
+
+    TaskList (QueuedTask *head, QueuedTask *tail) noexcept
+      : _head(head)
+      , _tail(tail)
+    {}
+
+    TaskList (const TaskList &) = delete;
+    TaskList &operator= (const TaskList &) = delete;
+
+    TaskList (TaskList &&other) noexcept
+      : _head(other._head)
+      , _tail(other._tail)
+    {
+      other._head = other._tail = nullptr;
+    }
+
+    TaskList &operator= (TaskList &&other) noexcept
+    {
+      if (&other != this) {
+        clear();
+
+        _head = other._head;
+        _tail = other._tail;
+        other._head = other._tail = nullptr;
+      }
+
+      return *this;
+    }
+
+    ~TaskList ()
+    {
+      clear();
+    }
+
+    bool empty () const noexcept
+    {
+      return _head == nullptr;
+    }
+
+    /// Invokes the first task, then removes it from the list. The list must
+    /// not be empty.
+    void runFront ()
+    {
+      QueuedTask *node = _head;
+
+      // Remove the node first, in case the task throws.
+      if (!(_head = node->_queueNext)) {
+        _tail = nullptr;
+      }
+
+      struct Recycler final
+      {
+        QueuedTask *_node;
+
+        ~Recycler ()
+        {
+          QueuedTask::recycle(_node);
+        }
+      } recycler{node};
+
+      node->_task();
+    }
+
+    /// Removes the first task without invoking it. The list must not be
+    /// empty.
+    void dropFront () noexcept
+    {
+      QueuedTask *node = _head;
+
+      if (!(_head = node->_queueNext)) {
+        _tail = nullptr;
+      }
+
+      QueuedTask::recycle(node);
+    }
+
+    /// Moves every task from the other list onto the end of this one.
+    void append (TaskList &&other) noexcept
+    {
+      if (other.empty()) {
+        return;
+      }
+
+      if (_tail) {
+        _tail->_queueNext = other._head;
+      } else {
+        _head = other._head;
+      }
+
+      _tail = other._tail;
+      other._head = other._tail = nullptr;
+    }
+
+    /// Removes every task without invoking them.
+    void clear () noexcept
+    {
+      while (_head) {
+        dropFront();
+      }
+    }
+
+  private:
+    QueuedTask *_head;
+    QueuedTask *_tail;
+};
+
+/// An intrusive, lock-free queue of tasks, which supports any number of
+/// concurrent producers and one consumer.
+class TaskQueue final
+{
+  public:
+    TaskQueue () noexcept = default;
+
+    TaskQueue (const TaskQueue &) = delete;
+    TaskQueue &operator= (const TaskQueue &) = delete;
+
+    ~TaskQueue ()
+    {
+      popAll();
+    }
+
+    /// Adds a task to the back of the queue. This is safe to call from any
+    /// thread.
+    ///
+    /// Returns whether the queue was empty beforehand.
+    bool push (Task task)
+    {
+      return _queue.push(QueuedTask::create(std::move(task)));
+    }
+
+    bool empty () const noexcept
+    {
+      return _queue.empty();
+    }
+
+    /// Removes every task from the queue, in FIFO order. This must only be
+    /// called from the consumer.
+    TaskList popAll () noexcept
+    {
+      QueuedTask *tail = nullptr;
+      QueuedTask *head = _queue.popAll(&tail);
+
+      return TaskList(head, tail);
+    }
+
+  private:
+    MPSCQueue<QueuedTask> _queue;
+};
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "ThreadPlacement.h"
+
+#include <cerrno>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "PlatformSupport.h"
+
+#if __has_include(<sched.h>)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace fb::sinkline;
+
+namespace {
+
+// Parses a Linux CPU list, like "0-3,8,10-11".
+std::vector<unsigned> parseCPUList (const std::string &list)
+{
+  std::vector<unsigned> cpus;
+  std::istringstream stream(list);
+  std::string range;
+
+  while (std::getline(stream, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+
+    unsigned first = 0, last = 0;
+    char dash = 0;
+
+    std::istringstream rangeStream(range);
+    rangeStream >> first;
+
+    if (rangeStream >> dash && dash == '-') {
+      rangeStream >> last;
+    } else {
+      last = first;
+    }
+
+    if (rangeStream.fail() && !rangeStream.eof()) {
+      throw std::system_error(EINVAL, std::system_category(), "malformed CPU list");
+    }
+
+    for (unsigned cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return cpus;
+}
+
+}
+
+ThreadPlacement ThreadPlacement::numaNode (unsigned node)
+{
+  std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string list;
+
+  if (!std::getline(file, list)) {
+    throw std::system_error(ENOENT, std::system_category(), "could not read CPUs of NUMA node " + std::to_string(node));
+  }
+
+  auto cpus = parseCPUList(list);
+  if (cpus.empty()) {
+    throw std::system_error(ENOENT, std::system_category(), "NUMA node " + std::to_string(node) + " has no CPUs");
+  }
+
+  return ThreadPlacement(std::move(cpus));
+}
+
+void ThreadPlacement::applyToCurrentThread () const
+{
+  if (isUnrestricted()) {
+    return;
+  }
+
+#ifdef CPU_SET
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  for (unsigned cpu : _cpus) {
+    if (cpu >= CPU_SETSIZE) {
+      throw std::system_error(EINVAL, std::system_category(), "CPU number out of range");
+    }
+
+    CPU_SET(cpu, &set);
+  }
+
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (error != 0) {
+    throw std::system_error(error, std::system_category(), "pthread_setaffinity_np");
+  }
+#else
+  throw std::system_error(ENOTSUP, std::system_category(), "thread pinning is not supported on this platform");
+#endif
+}
+
+void fb::sinkline::startDetachedThread (const ThreadPlacement &placement, Task main)
+{
+  if (placement.isUnrestricted()) {
+    std::thread(std::move(main)).detach();
+    return;
+  }
+
+  std::promise<void> pinned;
+  auto future = pinned.get_future();
+
+  std::thread([placement, pinned = std::move(pinned), main = std::move(main)]() mutable {
+    try {
+      placement.applyToCurrentThread();
+    } catch (...) {
+      pinned.set_exception(std::current_exception());
+      return;
+    }
+
+    pinned.set_value();
+    main();
+  }).detach();
+
+  future.get();
+}
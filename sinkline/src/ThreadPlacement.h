@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_THREAD_PLACEMENT_H
+#define FB_SINKLINE_THREAD_PLACEMENT_H
+
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+namespace fb { namespace sinkline {
+
+/// Describes which CPUs a scheduler thread is allowed to run upon.
+///
+/// A default-constructed placement does not restrict the thread at all.
+/// Pinning is currently only supported on Linux.
+///
+/// This only controls where the thread runs. Queued tasks are allocated by
+/// whichever thread schedules them, but are only ever recycled for producers
+/// on the same NUMA node (see QueuedTask), so pinning producers and their
+/// scheduler to one node keeps task memory on that node too.
+class ThreadPlacement final
+{
+  public:
+    ThreadPlacement () noexcept = default;
+
+    /// Restricts the thread to the given CPU numbers.
+    explicit ThreadPlacement (std::vector<unsigned> cpus) noexcept
+      : _cpus(std::move(cpus))
+    {}
+
+    /// Restricts the thread to the CPUs of the given NUMA node.
+    ///
+    /// Throws std::system_error if the node's CPUs cannot be determined.
+    static ThreadPlacement numaNode (unsigned node);
+
+    /// The CPUs that the thread may run upon, or an empty list if the thread
+    /// is unrestricted.
+    const std::vector<unsigned> &cpus () const noexcept
+    {
+      return _cpus;
+    }
+
+    bool isUnrestricted () const noexcept
+    {
+      return _cpus.empty();
+    }
+
+    /// Pins the calling thread to this placement.
+    ///
+    /// Throws std::system_error if the thread cannot be pinned (e.g., because
+    /// none of the CPUs are online, or pinning is unsupported).
+    void applyToCurrentThread () const;
+
+  private:
+    std::vector<unsigned> _cpus;
+};
+
+/// Starts a detached thread which pins itself to the given placement before
+/// invoking `main`.
+///
+/// If the placement is restricted, this waits for the new thread to pin
+/// itself, and rethrows any failure to do so (in which case `main` is never
+/// invoked).
+void startDetachedThread (const ThreadPlacement &placement, Task main);
+
+} } // namespace fb::sinkline
+
+#endif
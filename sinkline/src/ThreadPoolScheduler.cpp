@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "ThreadPoolScheduler.h"
+
+#include <limits>
+
+using namespace fb::sinkline;
+
+namespace {
+
+// Identifies the pool (and worker within it) that the current thread belongs
+// to, if any.
+thread_local const void *currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+}
+
+ThreadPoolScheduler::State::State (unsigned threadCount)
+  : _pending(0)
+  , _nextWorker(0)
+  , _running(true)
+  , _sleeping(0)
+  , _nextDeadline(std::numeric_limits<std::chrono::steady_clock::rep>::max())
+  , _timerWaiter(false)
+{
+  _workers.reserve(threadCount);
+
+  for (unsigned i = 0; i < threadCount; i++) {
+    _workers.emplace_back(new Worker);
+  }
+}
+
+void ThreadPoolScheduler::State::updateNextDeadline () noexcept
+{
+  if (_timers.empty()) {
+    _nextDeadline = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+  } else {
+    _nextDeadline = _timers.nextDeadline().time_since_epoch().count();
+  }
+}
+
+ThreadPoolScheduler::ThreadPoolScheduler (unsigned threadCount)
+  : ThreadPoolScheduler(threadCount, {})
+{}
+
+ThreadPoolScheduler::ThreadPoolScheduler (unsigned threadCount, std::vector<ThreadPlacement> placements)
+  : _state(std::make_shared<State>(threadCount > 0 ? threadCount : 1))
+{
+  try {
+    for (unsigned i = 0; i < _state->_workers.size(); i++) {
+      ThreadPlacement placement;
+      if (!placements.empty()) {
+        placement = placements[i % placements.size()];
+      }
+
+      startDetachedThread(placement, [state = _state, i] {
+        detachedWorkerMain(state, i);
+      });
+    }
+  } catch (...) {
+    // Stop any workers which did start, since the destructor won't run.
+    shutdown();
+    throw;
+  }
+}
+
+void ThreadPoolScheduler::shutdown ()
+{
+  {
+    std::lock_guard<std::mutex> guard(_state->_mutex);
+    _state->_running = false;
+  }
+
+  _state->_condition.notify_all();
+}
+
+bool ThreadPoolScheduler::isCurrent () const noexcept
+{
+  return currentPool == _state.get();
+}
+
+void ThreadPoolScheduler::enqueue (Task action)
+{
+  State &state = *_state;
+
+  unsigned index;
+  if (currentPool == &state) {
+    index = currentWorker;
+  } else {
+    index = state._nextWorker.fetch_add(1, std::memory_order_relaxed) % state._workers.size();
+  }
+
+  // This is incremented before the action is visible, so that a worker will
+  // never observe zero pending actions while one is sitting in a deque.
+  state._pending.fetch_add(1);
+
+  {
+    Worker &worker = *state._workers[index];
+
+    std::lock_guard<std::mutex> guard(worker._mutex);
+    worker._deque.push_back(std::move(action));
+  }
+
+  if (state._sleeping.load() > 0) {
+    // Taking the lock guarantees that a worker which has decided to sleep is
+    // already waiting on the condition, so this notification can't be lost.
+    std::lock_guard<std::mutex> guard(state._mutex);
+    state._condition.notify_one();
+  }
+}
+
+void ThreadPoolScheduler::enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action)
+{
+  State &state = *_state;
+  std::lock_guard<std::mutex> guard(state._mutex);
+
+  if (state._timers.push(deadline, std::move(action))) {
+    state.updateNextDeadline();
+
+    // Any worker waiting for timers is waiting for a later deadline.
+    if (state._sleeping > 0) {
+      state._condition.notify_all();
+    }
+  }
+}
+
+void ThreadPoolScheduler::pushActions (State &state, unsigned index, std::vector<Task> &actions)
+{
+  state._pending.fetch_add(actions.size());
+
+  {
+    Worker &worker = *state._workers[index];
+
+    std::lock_guard<std::mutex> guard(worker._mutex);
+    for (auto &action : actions) {
+      worker._deque.push_back(std::move(action));
+    }
+  }
+
+  // This worker will take the first action itself, so only wake others if
+  // there's more to do.
+  if (actions.size() > 1 && state._sleeping.load() > 0) {
+    std::lock_guard<std::mutex> guard(state._mutex);
+    state._condition.notify_all();
+  }
+
+  actions.clear();
+}
+
+void ThreadPoolScheduler::collectExpiredTimers (State &state, unsigned index, std::vector<Task> &expired)
+{
+  using Clock = std::chrono::steady_clock;
+
+  if (state._nextDeadline == std::numeric_limits<Clock::rep>::max() || Clock::now().time_since_epoch().count() < state._nextDeadline) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(state._mutex);
+
+    state._timers.popExpired(Clock::now(), expired);
+    state.updateNextDeadline();
+  }
+
+  if (!expired.empty()) {
+    pushActions(state, index, expired);
+  }
+}
+
+bool ThreadPoolScheduler::takeAction (State &state, unsigned index, Task &action)
+{
+  {
+    Worker &own = *state._workers[index];
+
+    std::lock_guard<std::mutex> guard(own._mutex);
+    if (!own._deque.empty()) {
+      action = std::move(own._deque.front());
+      own._deque.pop_front();
+      return true;
+    }
+  }
+
+  size_t count = state._workers.size();
+
+  for (size_t offset = 1; offset < count; offset++) {
+    Worker &victim = *state._workers[(index + offset) % count];
+
+    std::unique_lock<std::mutex> victimGuard(victim._mutex);
+    if (victim._deque.empty()) {
+      continue;
+    }
+
+    action = std::move(victim._deque.back());
+    victim._deque.pop_back();
+
+    // Take up to half of whatever remains, so that this worker doesn't have
+    // to come back to the same victim for each action.
+    size_t stealCount = victim._deque.size() / 2;
+    if (stealCount == 0) {
+      return true;
+    }
+
+    std::deque<Task> stolen;
+    for (size_t i = 0; i < stealCount; i++) {
+      stolen.push_front(std::move(victim._deque.back()));
+      victim._deque.pop_back();
+    }
+
+    victimGuard.unlock();
+
+    Worker &own = *state._workers[index];
+
+    std::lock_guard<std::mutex> guard(own._mutex);
+    for (auto &stolenAction : stolen) {
+      own._deque.push_back(std::move(stolenAction));
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+void ThreadPoolScheduler::detachedWorkerMain (std::shared_ptr<State> state, unsigned index)
+{
+  currentPool = state.get();
+  currentWorker = index;
+
+  Task action;
+
+  // Reused for each batch of timers, to avoid allocating every time.
+  std::vector<Task> expired;
+
+  while (state->_running.load(std::memory_order_relaxed)) {
+    collectExpiredTimers(*state, index, expired);
+
+    if (takeAction(*state, index, action)) {
+      state->_pending.fetch_sub(1);
+
+      action();
+      action.reset();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(state->_mutex);
+    ++state->_sleeping;
+
+    bool wasTimerWaiter = false;
+
+    while (state->_pending.load() == 0 && state->_running) {
+      if (state->_timers.empty() || (state->_timerWaiter && !wasTimerWaiter)) {
+        state->_condition.wait(guard);
+      } else if (std::chrono::steady_clock::now() < state->_timers.nextDeadline()) {
+        // Only one worker waits for timers, so that they don't all wake up
+        // for each deadline.
+        state->_timerWaiter = wasTimerWaiter = true;
+        state->_condition.wait_until(guard, state->_timers.nextDeadline());
+      } else {
+        break;
+      }
+    }
+
+    --state->_sleeping;
+
+    if (wasTimerWaiter) {
+      state->_timerWaiter = false;
+
+      // Hand off waiting for any remaining timers to another idle worker,
+      // since this one may be busy for a while.
+      if (!state->_timers.empty() && state->_sleeping > 0) {
+        state->_condition.notify_one();
+      }
+    }
+  }
+}
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_THREAD_POOL_SCHEDULER_H
+#define FB_SINKLINE_THREAD_POOL_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Scheduler.h"
+#include "Task.h"
+#include "ThreadPlacement.h"
+#include "TimerQueue.h"
+
+namespace fb { namespace sinkline {
+
+/// Runs actions upon a fixed number of detached worker threads.
+///
+/// Each worker owns a deque of pending actions. Actions scheduled from one of
+/// the pool's own workers are pushed onto that worker's deque, while actions
+/// scheduled from any other thread are distributed round-robin. An idle worker
+/// will steal from the other workers' deques before going to sleep.
+///
+/// No ordering is guaranteed between actions, since they may run concurrently.
+class ThreadPoolScheduler final
+{
+  public:
+    explicit ThreadPoolScheduler (unsigned threadCount = std::thread::hardware_concurrency());
+
+    /// Creates a pool whose workers are pinned to the given placements. Worker
+    /// `i` uses `placements[i % placements.size()]`, so (e.g.) a list with
+    /// one placement per CPU spreads the workers across those CPUs, while a
+    /// single NUMA node placement keeps every worker on that node.
+    ///
+    /// Throws std::system_error if any worker cannot be pinned.
+    ThreadPoolScheduler (unsigned threadCount, std::vector<ThreadPlacement> placements);
+
+    ThreadPoolScheduler (const ThreadPoolScheduler &) = delete;
+    ThreadPoolScheduler &operator= (const ThreadPoolScheduler &) = delete;
+
+    ThreadPoolScheduler (ThreadPoolScheduler &&) = default;
+    ThreadPoolScheduler &operator= (ThreadPoolScheduler &&) = default;
+
+    ~ThreadPoolScheduler ()
+    {
+      if (_state) {
+        shutdown();
+      }
+    }
+
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      enqueue([promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// Like schedule(), but discards the result of the action instead of
+    /// creating a std::future for it.
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      enqueue([call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
+
+    /// Like post(), but runs the action immediately if this is called from
+    /// one of the pool's workers. Since the pool doesn't order its actions,
+    /// this can't run anything out of order.
+    template<typename F, typename ...Args>
+    void dispatch (F &&action, Args &&...args)
+    {
+      if (isCurrent()) {
+        runDiscardedAction(std::forward<F>(action), std::forward<Args>(args)...);
+      } else {
+        post(std::forward<F>(action), std::forward<Args>(args)...);
+      }
+    }
+
+    /// Whether the calling thread is one of this pool's workers.
+    bool isCurrent () const noexcept;
+
+    /// Like schedule(), but waits until the given time before running the
+    /// action.
+    ///
+    /// Pending timers are kept in a heap shared by the pool. One idle worker
+    /// at a time waits for the earliest deadline, and expired timers are then
+    /// distributed like any other action.
+    template<typename Clock, typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock> timePoint, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      enqueueAfter(toSteadyTimePoint(timePoint), [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// The number of worker threads in this pool.
+    unsigned threadCount () const noexcept
+    {
+      return static_cast<unsigned>(_state->_workers.size());
+    }
+
+    void shutdown ();
+
+  private:
+    struct Worker {
+      std::mutex _mutex;
+
+      // Must be synchronized on _mutex. The owning worker takes from the
+      // front, and thieves take from the back.
+      std::deque<Task> _deque;
+    };
+
+    struct State {
+      std::vector<std::unique_ptr<Worker>> _workers;
+
+      // The number of actions which have been enqueued but not yet taken by
+      // a worker.
+      std::atomic<size_t> _pending;
+
+      // Used to pick a worker for actions scheduled from outside the pool.
+      std::atomic<unsigned> _nextWorker;
+
+      std::atomic<bool> _running;
+
+      // Idle workers sleep on _condition. _sleeping must only be modified
+      // while holding _mutex.
+      std::mutex _mutex;
+      std::condition_variable _condition;
+      std::atomic<unsigned> _sleeping;
+
+      // The deadline of the earliest timer, in steady_clock ticks (or the
+      // maximum value, if there are no timers). This lets workers check for
+      // expired timers without locking.
+      std::atomic<std::chrono::steady_clock::rep> _nextDeadline;
+
+      // These fields must be synchronized on _mutex.
+      TimerQueue<> _timers;
+      bool _timerWaiter;
+
+      State (unsigned threadCount);
+
+      // Must be called while holding _mutex.
+      void updateNextDeadline () noexcept;
+    };
+
+    std::shared_ptr<State> _state;
+
+    void enqueue (Task action);
+    void enqueueAfter (std::chrono::steady_clock::time_point deadline, Task action);
+
+    static void pushActions (State &state, unsigned index, std::vector<Task> &actions);
+    static void collectExpiredTimers (State &state, unsigned index, std::vector<Task> &expired);
+
+    static bool takeAction (State &state, unsigned index, Task &action);
+    static void detachedWorkerMain (std::shared_ptr<State> state, unsigned index);
+};
+
+} } // namespace fb::sinkline
+
+#endif
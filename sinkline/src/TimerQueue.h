@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_TIMER_QUEUE_H
+#define FB_SINKLINE_TIMER_QUEUE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+namespace fb { namespace sinkline {
+
+/// Converts a time point from any clock into the steady clock that the
+/// schedulers use for timers.
+///
+/// Time points from other clocks are converted based on their distance from
+/// that clock's current time, so later adjustments to (e.g.) the system clock
+/// will not affect when the converted time point is reached.
+template<typename Clock, typename Duration>
+std::chrono::steady_clock::time_point toSteadyTimePoint (std::chrono::time_point<Clock, Duration> timePoint)
+{
+  auto delta = std::chrono::duration_cast<std::chrono::steady_clock::duration>(timePoint - Clock::now());
+  return std::chrono::steady_clock::now() + delta;
+}
+
+template<typename Duration>
+std::chrono::steady_clock::time_point toSteadyTimePoint (std::chrono::time_point<std::chrono::steady_clock, Duration> timePoint)
+{
+  return std::chrono::time_point_cast<std::chrono::steady_clock::duration>(timePoint);
+}
+
+/// A priority queue of tasks, ordered by the time at which they should run.
+/// Tasks with the same deadline are kept in the order they were added.
+///
+/// Adding and removing tasks are both O(log n). This type is not thread-safe.
+template<typename TimePoint = std::chrono::steady_clock::time_point>
+class TimerQueue final
+{
+  public:
+    using time_point = TimePoint;
+
+    TimerQueue () noexcept
+      : _nextSequence(0)
+    {}
+
+    TimerQueue (const TimerQueue &) = delete;
+    TimerQueue &operator= (const TimerQueue &) = delete;
+
+    TimerQueue (TimerQueue &&) = default;
+    TimerQueue &operator= (TimerQueue &&) = default;
+
+    /// Adds a task which should run at the given time.
+    ///
+    /// Returns whether the task is now the earliest in the queue, in which
+    /// case anyone waiting on nextDeadline() will need to be woken up.
+    bool push (time_point deadline, Task task)
+    {
+      _heap.push_back(Entry{deadline, _nextSequence++, std::move(task)});
+      std::push_heap(_heap.begin(), _heap.end(), Later());
+
+      return _heap.front()._sequence == _nextSequence - 1;
+    }
+
+    bool empty () const noexcept
+    {
+      return _heap.empty();
+    }
+
+    size_t size () const noexcept
+    {
+      return _heap.size();
+    }
+
+    /// The deadline of the earliest task. The queue must not be empty.
+    ///
+    /// This is returned by value, because callers commonly wait on it after
+    /// releasing the lock which guards the queue.
+    time_point nextDeadline () const noexcept
+    {
+      return _heap.front()._deadline;
+    }
+
+    /// Removes and returns the earliest task. The queue must not be empty.
+    Task pop ()
+    {
+      std::pop_heap(_heap.begin(), _heap.end(), Later());
+
+      Task task = std::move(_heap.back()._task);
+      _heap.pop_back();
+
+      return task;
+    }
+
+    /// Removes every task whose deadline is at or before `now`, appending them
+    /// to `expired` (which should be a container of Tasks) in deadline order.
+    ///
+    /// Returns the number of tasks removed.
+    template<typename Container>
+    size_t popExpired (time_point now, Container &expired)
+    {
+      size_t count = 0;
+
+      while (!_heap.empty() && !(now < _heap.front()._deadline)) {
+        expired.push_back(pop());
+        count++;
+      }
+
+      return count;
+    }
+
+  private:
+    struct Entry {
+      time_point _deadline;
+      uint64_t _sequence;
+      Task _task;
+    };
+
+    // std::push_heap builds a max-heap, so this is reversed to put the
+    // earliest deadline at the front.
+    struct Later final
+    {
+      bool operator() (const Entry &lhs, const Entry &rhs) const noexcept
+      {
+        if (lhs._deadline == rhs._deadline) {
+          return lhs._sequence > rhs._sequence;
+        } else {
+          return rhs._deadline < lhs._deadline;
+        }
+      }
+    };
+
+    std::vector<Entry> _heap;
+    uint64_t _nextSequence;
+};
+
+} } // namespace fb::sinkline
+
+#endif
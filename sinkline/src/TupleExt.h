@@ -10,6 +10,7 @@
 #ifndef FB_SINKLINE_TUPLE_EXT_H
 #define FB_SINKLINE_TUPLE_EXT_H
 
+#include <cstddef>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -49,73 +50,115 @@ auto callWithTuple (Callable &&fn, Tuple &&tuple)
   return TupleCallWrapper<std::make_index_sequence<tupleSize>>::call(std::forward<Callable>(fn), std::forward<Tuple>(tuple));
 }
 
-/// Implements the behavior of extract() by recursively invoking itself.
-template<typename Extract, typename... Remaining>
-struct ExtractWrapper final
+/// Converts a tuple of references into a tuple of values, moving or copying
+/// from whatever the references refer to (according to their value
+/// categories).
+template<typename... Elements>
+std::tuple<std::decay_t<Elements>...> decayTuple (std::tuple<Elements...> &&tuple)
 {
-  public:
-    ExtractWrapper () = delete;
+  return std::tuple<std::decay_t<Elements>...>(std::move(tuple));
+}
 
-    static auto extract(Extract* /*extracted*/) {
-      return std::make_tuple();
-    }
+/// The index of the first type in `Inputs` which (ignoring references and
+/// cv-qualifiers) is `Extract`, or the number of types if none are.
+template<typename Extract, typename... Inputs>
+struct ExtractIndex;
+
+template<typename Extract>
+struct ExtractIndex<Extract> final
+{
+  public:
+    static constexpr size_t value = 0;
 };
 
 template<typename Extract, typename Next, typename... Remaining>
-struct ExtractWrapper<Extract, Next, Remaining...> final
+struct ExtractIndex<Extract, Next, Remaining...> final
 {
   public:
-    ExtractWrapper () = delete;
-
-    static auto extract (Extract *extracted, const Next &next, const Remaining &...remaining)
-    {
-      auto nextTuple = std::make_tuple(next);
-      auto remainingTuple = ExtractWrapper<Extract, Remaining...>::extract(extracted, remaining...);
-
-      return std::tuple_cat(nextTuple, remainingTuple);
-    }
+    static constexpr size_t value = std::is_same<std::decay_t<Next>, Extract>::value ? 0 : 1 + ExtractIndex<Extract, Remaining...>::value;
 };
 
-template<typename Extract, typename... Remaining>
-struct ExtractWrapper<Extract, Extract, Remaining...> final
+/// Implements the behavior of extract(), given the index of the element to
+/// remove and the indices of the elements around it.
+template<size_t Index, typename Before, typename After>
+struct ExtractWrapper;
+
+template<size_t Index, size_t... Before, size_t... After>
+struct ExtractWrapper<Index, std::index_sequence<Before...>, std::index_sequence<After...>> final
 {
   public:
     ExtractWrapper () = delete;
 
-    static auto extract (Extract *extracted, const Extract &next, const Remaining &...remaining)
+    /// Returns a tuple of references to every element of `tuple` except the
+    /// one at `Index`. If there is an element at `Index`, and `extracted` is
+    /// not NULL, the element is also copied into it.
+    template<typename Extract, typename Tuple>
+    static auto extract (Tuple &&tuple, Extract *extracted)
+    {
+      copyExtracted(tuple, extracted, std::integral_constant<bool, (Index < std::tuple_size<std::decay_t<Tuple>>::value)>());
+
+      return std::forward_as_tuple(std::get<Before>(std::forward<Tuple>(tuple))..., std::get<Index + 1 + After>(std::forward<Tuple>(tuple))...);
+    }
+
+  private:
+    template<typename Extract, typename Tuple>
+    static void copyExtracted (const Tuple &tuple, Extract *extracted, std::true_type)
     {
       if (extracted) {
-        *extracted = next;
+        *extracted = std::get<Index>(tuple);
       }
-
-      return ExtractWrapper<Extract, Remaining...>::extract(extracted, remaining...);
     }
+
+    template<typename Extract, typename Tuple>
+    static void copyExtracted (const Tuple &, Extract *, std::false_type) noexcept
+    {}
 };
 
-/// Removes a value from a tuple based on its type, returning a new tuple with
-/// one fewer element.
+/// Selects the ExtractWrapper which removes `Extract` from `Inputs`.
+template<typename Extract, typename... Inputs>
+using ExtractWrapperFor = ExtractWrapper<
+  ExtractIndex<Extract, Inputs...>::value,
+  std::make_index_sequence<ExtractIndex<Extract, Inputs...>::value>,
+  std::make_index_sequence<(ExtractIndex<Extract, Inputs...>::value < sizeof...(Inputs) ? sizeof...(Inputs) - ExtractIndex<Extract, Inputs...>::value - 1 : 0)>
+>;
+
+/// Removes a value from a tuple based on its type, returning a tuple of
+/// references to the remaining elements.
+///
+/// Nothing is copied except the removed value, but the result refers to the
+/// elements of `tuple`, so it must not outlive it.
 ///
 /// @param tuple The tuple to remove the element from.
 /// @param extracted If not NULL, set to the value of the removed element.
 template<typename Extract, typename... Inputs>
 auto extract (const std::tuple<Inputs...> &tuple, Extract *extracted)
 {
-  auto callable = [extracted](auto &...inputs) {
-    return ExtractWrapper<Extract, Inputs...>::extract(extracted, inputs...);
-  };
+  return ExtractWrapperFor<Extract, Inputs...>::extract(tuple, extracted);
+}
 
-  return callWithTuple(callable, tuple);
+/// Like the overload above, but for a temporary tuple, returns a tuple of the
+/// remaining values (moved out of `tuple`) rather than references to them,
+/// since the references would dangle once the temporary is destroyed.
+template<typename Extract, typename... Inputs>
+auto extract (std::tuple<Inputs...> &&tuple, Extract *extracted)
+{
+  return decayTuple(ExtractWrapperFor<Extract, Inputs...>::extract(std::move(tuple), extracted));
 }
 
-/// Removes a value from an argument list based on its type, returning a tuple with
-/// one fewer element than the argument list.
+/// Removes a value from an argument list based on its type, returning a tuple
+/// of references to the remaining arguments, which preserve their value
+/// categories (as with std::forward_as_tuple).
+///
+/// Nothing is copied except the removed value, but the result refers to the
+/// arguments, so it must not outlive them. Pass it to callWithTuple() as an
+/// rvalue to forward the arguments onward.
 ///
 /// @param extracted If not NULL, set to the value of the removed argument.
 /// @param inputs The argument list from which to remove the element.
 template<typename Extract, typename... Inputs>
 auto extract (Extract *extracted, Inputs &&...inputs)
 {
-  return ExtractWrapper<Extract, Inputs...>::extract(extracted, std::forward<Inputs>(inputs)...);
+  return ExtractWrapperFor<Extract, Inputs...>::extract(std::forward_as_tuple(std::forward<Inputs>(inputs)...), extracted);
 }
 
 /// Attempts to flatten the Optional values in the stored tuple into a single
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "VirtualTimeScheduler.h"
+
+#include <stdexcept>
+
+using namespace fb::sinkline;
+
+uint64_t VirtualTimeScheduler::advanceTo (time_point target)
+{
+  uint64_t count = 0;
+
+  while (runNext(&target)) {
+    count++;
+  }
+
+  std::lock_guard<std::mutex> guard(_mutex);
+
+  if (_now < target) {
+    _now = target;
+  }
+
+  return count;
+}
+
+uint64_t VirtualTimeScheduler::runUntilIdle ()
+{
+  uint64_t count = 0;
+
+  while (runNext(nullptr)) {
+    count++;
+  }
+
+  return count;
+}
+
+void VirtualTimeScheduler::enqueue (time_point deadline, Task action)
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+
+  // Don't let anything be scheduled in the past, or it would run before
+  // actions which are already due.
+  if (deadline < _now) {
+    deadline = _now;
+  }
+
+  _timers.push(deadline, std::move(action));
+}
+
+bool VirtualTimeScheduler::runNext (const time_point *limit)
+{
+  Task action;
+
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+
+    if (_timers.empty() || (limit && *limit < _timers.nextDeadline())) {
+      return false;
+    }
+
+    if (_running) {
+      throw std::logic_error("VirtualTimeScheduler cannot be advanced from within one of its actions");
+    }
+
+    _now = _timers.nextDeadline();
+    action = _timers.pop();
+    _running = true;
+  }
+
+  action();
+
+  std::lock_guard<std::mutex> guard(_mutex);
+  _running = false;
+
+  return true;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#ifndef FB_SINKLINE_VIRTUAL_TIME_SCHEDULER_H
+#define FB_SINKLINE_VIRTUAL_TIME_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <utility>
+
+#include "Scheduler.h"
+#include "Task.h"
+#include "TimerQueue.h"
+
+namespace fb { namespace sinkline {
+
+/// Runs actions upon whichever thread advances its clock, which only moves
+/// when told to.
+///
+/// This is meant for testing and benchmarking timed pipelines: instead of
+/// sleeping, a test schedules actions (or builds sinklines with scheduleOn()),
+/// then calls advanceBy() or runUntilIdle() to run them deterministically, in
+/// deadline order, with now() reporting each action's deadline as it runs.
+///
+/// Actions may be scheduled from any thread, but the clock should only be
+/// advanced from one thread at a time.
+class VirtualTimeScheduler final
+{
+  public:
+    /// The clock used for time points on this scheduler. It deliberately has
+    /// no static now(), since each scheduler has its own time; use
+    /// VirtualTimeScheduler::now() instead.
+    struct Clock final
+    {
+      using duration = std::chrono::nanoseconds;
+      using rep = duration::rep;
+      using period = duration::period;
+      using time_point = std::chrono::time_point<Clock>;
+
+      static constexpr bool is_steady = true;
+    };
+
+    using duration = Clock::duration;
+    using time_point = Clock::time_point;
+
+    VirtualTimeScheduler () noexcept
+      : _now(time_point())
+      , _running(false)
+    {}
+
+    VirtualTimeScheduler (const VirtualTimeScheduler &) = delete;
+    VirtualTimeScheduler &operator= (const VirtualTimeScheduler &) = delete;
+
+    /// Schedules an action to run at the current virtual time, after any
+    /// actions which are already due.
+    template<typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> schedule (F &&action, Args &&...args)
+    {
+      return scheduleAfter(now(), std::forward<F>(action), std::forward<Args>(args)...);
+    }
+
+    template<typename F, typename ...Args>
+    void post (F &&action, Args &&...args)
+    {
+      enqueue(now(), [call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runDiscardedAction(std::move(call));
+      });
+    }
+
+    /// Schedules an action to run once the virtual clock reaches the given
+    /// time. Time points in the past run at the current time instead.
+    template<typename Duration, typename F, typename ...Args>
+    std::future<ScheduledResult<F, Args...>> scheduleAfter (std::chrono::time_point<Clock, Duration> timePoint, F &&action, Args &&...args)
+    {
+      std::promise<ScheduledResult<F, Args...>> promise;
+      auto future = promise.get_future();
+
+      enqueue(std::chrono::time_point_cast<duration>(timePoint), [promise = std::move(promise), call = deferCall(std::forward<F>(action), std::forward<Args>(args)...)]() mutable {
+        runPromisedAction(promise, std::move(call));
+      });
+
+      return future;
+    }
+
+    /// The current virtual time. While an action is running, this is the time
+    /// it was scheduled for.
+    time_point now () const
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      return _now;
+    }
+
+    /// The number of actions waiting to run.
+    size_t pendingCount () const
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      return _timers.size();
+    }
+
+    /// Runs every action due at or before the given time (including any that
+    /// they schedule in the meantime), then sets the clock to that time.
+    ///
+    /// Returns the number of actions run.
+    uint64_t advanceTo (time_point target);
+
+    uint64_t advanceBy (duration delta)
+    {
+      return advanceTo(now() + delta);
+    }
+
+    /// Runs actions, moving the clock forward to each one's deadline, until
+    /// none remain.
+    ///
+    /// Returns the number of actions run.
+    uint64_t runUntilIdle ();
+
+  private:
+    mutable std::mutex _mutex;
+
+    // These fields must be synchronized on _mutex.
+    time_point _now;
+    TimerQueue<time_point> _timers;
+    bool _running;
+
+    void enqueue (time_point deadline, Task action);
+
+    // Runs the earliest action if it's due at or before `limit`, returning
+    // whether there was one.
+    bool runNext (const time_point *limit);
+};
+
+} } // namespace fb::sinkline
+
+#endif
@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "TestCommon.h"
+
+#include <sinkline/Coroutines.h>
+#include <sinkline/Scheduler.h>
+
+// This is built as its own test target with a newer standard, so it should
+// never silently compile to nothing.
+#if __cplusplus > 201703L && !defined(__cpp_lib_coroutine)
+#error "CoroutinesTest requires a standard library with coroutine support"
+#endif
+
+#ifdef __cpp_lib_coroutine
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace fb::sinkline;
+
+namespace {
+
+Async<int> doubled (ThreadScheduler &scheduler, int value)
+{
+  co_await scheduler;
+  co_return value * 2;
+}
+
+Async<int> failing ()
+{
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+
+// Coroutine lambdas must not capture anything, since the closure will have
+// been destroyed by the time they resume, so these are written as functions.
+DetachedCoroutine reportThread (ThreadScheduler &scheduler, std::promise<std::thread::id> &promise)
+{
+  co_await scheduler;
+  promise.set_value(std::this_thread::get_id());
+}
+
+DetachedCoroutine reportSum (ThreadScheduler &scheduler, std::promise<int> &promise)
+{
+  int value = co_await doubled(scheduler, 5);
+  value += co_await doubled(scheduler, value);
+
+  try {
+    co_await failing();
+  } catch (const std::runtime_error &) {
+    value++;
+  }
+
+  promise.set_value(value);
+}
+
+// Sets a flag once destroyed, to observe when a coroutine frame goes away.
+struct DestroyFlag final
+{
+  public:
+    explicit DestroyFlag (bool &destroyed) noexcept
+      : _destroyed(destroyed)
+    {}
+
+    ~DestroyFlag ()
+    {
+      _destroyed = true;
+    }
+
+  private:
+    bool &_destroyed;
+};
+
+Async<int> doubledWithFlag (ThreadScheduler &scheduler, int value, bool &destroyed)
+{
+  DestroyFlag flag(destroyed);
+  co_await scheduler;
+  co_return value * 2;
+}
+
+DetachedCoroutine awaitWithFlags (ThreadScheduler &scheduler, bool &outerDestroyed, bool &innerDestroyed, bool &rejected, bool &finished)
+{
+  DestroyFlag flag(outerDestroyed);
+
+  try {
+    co_await doubledWithFlag(scheduler, 1, innerDestroyed);
+  } catch (const std::overflow_error &) {
+    rejected = true;
+  }
+
+  finished = true;
+}
+
+}
+
+TEST(CoroutinesTest, AwaitScheduler)
+{
+  ThreadScheduler s;
+
+  auto schedulerThread = s.schedule([] {
+    return std::this_thread::get_id();
+  }).get();
+
+  std::promise<std::thread::id> promise;
+
+  reportThread(s, promise);
+
+  auto future = promise.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), schedulerThread);
+}
+
+TEST(CoroutinesTest, AwaitAsync)
+{
+  ThreadScheduler s;
+  std::promise<int> promise;
+
+  reportSum(s, promise);
+
+  auto future = promise.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 31);
+}
+
+TEST(CoroutinesTest, ThenCoroutine)
+{
+  ThreadScheduler s;
+  auto promise = std::make_shared<std::promise<int>>();
+
+  auto sink = thenCoroutine([&s](int value) {
+    return doubled(s, value);
+  }).compose([promise](int result) {
+    promise->set_value(result);
+  });
+
+  sink(21);
+
+  auto future = promise->get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 42);
+}
+
+TEST(CoroutinesTest, AwaitOverflowingScheduler)
+{
+  for (auto policy : { ThreadScheduler::OverflowPolicy::DropNewest, ThreadScheduler::OverflowPolicy::Reject }) {
+    ThreadScheduler::Options options;
+    options.capacity = 1;
+    options.overflowPolicy = policy;
+
+    ThreadScheduler s(options);
+
+    // Fill the queue, so that the coroutine can't be resumed upon it.
+    s.suspend();
+    s.post([] {});
+
+    bool outerDestroyed = false;
+    bool innerDestroyed = false;
+    bool rejected = false;
+    bool finished = false;
+
+    awaitWithFlags(s, outerDestroyed, innerDestroyed, rejected, finished);
+
+    // Either way, neither coroutine should be left suspended forever.
+    EXPECT_TRUE(outerDestroyed);
+    EXPECT_TRUE(innerDestroyed);
+
+    if (policy == ThreadScheduler::OverflowPolicy::Reject) {
+      EXPECT_TRUE(rejected);
+      EXPECT_TRUE(finished);
+    } else {
+      EXPECT_FALSE(rejected);
+      EXPECT_FALSE(finished);
+    }
+
+    s.resume();
+  }
+}
+
+#endif
@@ -14,13 +14,25 @@
 #include <sinkline/Operators.h>
 #include <sinkline/Scheduler.h>
 #include <sinkline/Sinkline.h>
+#include <sinkline/ThreadPoolScheduler.h>
+#include <sinkline/VirtualTimeScheduler.h>
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace fb::sinkline;
 using namespace fb::sinkline::operators;
@@ -88,6 +100,114 @@ TEST(OperatorsTest, ScanUnlocked)
   EXPECT_EQ(scanSink(3), "7");
 }
 
+TEST(OperatorsTest, ScanInPlace)
+{
+  const std::vector<int> *previous = nullptr;
+
+  auto scanSink = scanInPlace(std::vector<int>(), [](std::vector<int> &values, int value) {
+    values.push_back(value);
+  }).compose([&previous](const std::vector<int> &values) {
+    // The accumulator itself should be forwarded every time, not a copy.
+    EXPECT_TRUE(previous == nullptr || previous == &values);
+    previous = &values;
+
+    return std::accumulate(values.begin(), values.end(), 0);
+  });
+
+  EXPECT_EQ(scanSink(1), 1);
+  EXPECT_EQ(scanSink(2), 3);
+  EXPECT_EQ(scanSink(3), 6);
+  EXPECT_EQ(previous->size(), 3u);
+}
+
+TEST(OperatorsTest, ScanInPlaceUnlocked)
+{
+  auto scanSink = scanInPlace<void>(std::string("a"), [](std::string &str, char c) {
+    str += c;
+  }).compose([](const std::string &str) {
+    return str;
+  });
+
+  EXPECT_EQ(scanSink('b'), "ab");
+  EXPECT_EQ(scanSink('c'), "abc");
+}
+
+TEST(OperatorsTest, AtomicScan)
+{
+  auto scanSink = atomicScan(1, [](int accumulated, int value) {
+    return accumulated + value;
+  }).compose([](int value) {
+    return std::to_string(value);
+  });
+
+  EXPECT_EQ(scanSink(0), "1");
+  EXPECT_EQ(scanSink(1), "2");
+  EXPECT_EQ(scanSink(2), "4");
+  EXPECT_EQ(scanSink(3), "7");
+}
+
+namespace {
+
+/// Feeds `iterations` ones into the sink from each of `threadCount` threads,
+/// then returns the result of feeding it one more zero.
+template<typename Sink>
+uint64_t countConcurrently (const Sink &sink, int threadCount, int iterations)
+{
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back([&sink, iterations] {
+      for (int j = 0; j < iterations; j++) {
+        sink(uint64_t(1));
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  return sink(uint64_t(0));
+}
+
+}
+
+TEST(OperatorsTest, AtomicScanConcurrently)
+{
+  auto scanSink = atomicScan(uint64_t(0), [](uint64_t sum, uint64_t value) {
+    return sum + value;
+  }).compose([](uint64_t sum) {
+    return sum;
+  });
+
+  EXPECT_EQ(countConcurrently(scanSink, 4, 10000), 40000u);
+}
+
+TEST(OperatorsTest, ShardedScan)
+{
+  // Use more threads than shards, so that some of them share.
+  auto scanSink = shardedScan(uint64_t(0), [](uint64_t sum, uint64_t value) {
+    return sum + value;
+  }, std::plus<uint64_t>(), 3).compose([](uint64_t sum) {
+    return sum;
+  });
+
+  EXPECT_EQ(scanSink(uint64_t(5)), 5u);
+  EXPECT_EQ(countConcurrently(scanSink, 4, 10000), 40005u);
+
+  auto maxSink = shardedScan(0, [](int accumulated, int value) {
+    return std::max(accumulated, value);
+  }).compose([](int value) {
+    return value;
+  });
+
+  EXPECT_EQ(maxSink(3), 3);
+  EXPECT_EQ(maxSink(1), 3);
+  EXPECT_EQ(maxSink(7), 7);
+
+  EXPECT_THROW(shardedScan(0, std::plus<int>(), std::plus<int>(), 0), std::invalid_argument);
+}
+
 TEST(OperatorsTest, IgnoreNull)
 {
   auto ignoreNullSink = ignoreNull().compose([](const char *str) {
@@ -110,9 +230,292 @@ TEST(OperatorsTest, Combine)
   EXPECT_EQ(std::get<0>(sumSink.sinks())(5).value(), "9");
 }
 
+TEST(OperatorsTest, CombineWithoutStdFunction)
+{
+  auto sumSinks = combine<int, int>([](int a, int b) {
+    return std::to_string(a + b);
+  });
+
+  static_assert(std::is_same<decltype(std::get<0>(sumSinks)(0)), Optional<std::string>>::value, "combine() should return the sink's result");
+
+  EXPECT_FALSE(bool(std::get<0>(sumSinks)(1)));
+  EXPECT_EQ(std::get<1>(sumSinks)(2).value(), "3");
+  EXPECT_EQ(std::get<1>(sumSinks)(4).value(), "5");
+  EXPECT_EQ(std::get<0>(sumSinks)(5).value(), "9");
+
+  int sum = 0;
+  auto voidSinks = combine<int, double>([&sum](int a, double b) {
+    sum += a + int(b);
+  });
+
+  EXPECT_FALSE(std::get<1>(voidSinks)(1.0));
+  EXPECT_TRUE(std::get<0>(voidSinks)(2));
+  EXPECT_TRUE(std::get<1>(voidSinks)(3.0));
+  EXPECT_EQ(sum, 8);
+}
+
+TEST(OperatorsTest, CombineN)
+{
+  const size_t count = 1000;
+
+  auto sinks = combineN<int>(count, [](ArrayView<int> values) {
+    return std::accumulate(values.begin(), values.end(), 0);
+  });
+
+  ASSERT_EQ(sinks.size(), count);
+
+  for (size_t i = 0; i < count - 1; i++) {
+    EXPECT_FALSE(bool(sinks[i](int(i))));
+  }
+
+  // Replacing an input that has already arrived shouldn't count toward
+  // readiness.
+  EXPECT_FALSE(bool(sinks[0](1)));
+
+  int expected = int((count - 1) * (count - 2) / 2) + 1;
+  EXPECT_EQ(sinks[count - 1](0).value(), expected);
+  EXPECT_EQ(sinks[5](6).value(), expected + 1);
+}
+
+TEST(OperatorsTest, CombineNConcurrently)
+{
+  const size_t count = 256;
+  const int threadCount = 4;
+
+  std::atomic<int> lastSum(0);
+
+  auto sinks = combineN<int>(count, [&lastSum](ArrayView<int> values) {
+    lastSum = std::accumulate(values.begin(), values.end(), 0);
+  });
+
+  // Each thread owns every threadCount-th input, and writes it a few times.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back([&sinks, i] {
+      for (int round = 1; round <= 3; round++) {
+        for (size_t j = size_t(i); j < count; j += threadCount) {
+          sinks[j](round);
+        }
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_TRUE(sinks[0](3));
+  EXPECT_EQ(lastSum.load(), int(count) * 3);
+}
+
+TEST(OperatorsTest, CombineNWithoutMutex)
+{
+  auto sinks = combineN<std::string, void>(2, [](ArrayView<std::string> values) {
+    return values[0] + values[1];
+  });
+
+  EXPECT_FALSE(bool(sinks[1]("bar")));
+  EXPECT_EQ(sinks[0]("foo").value(), "foobar");
+}
+
+TEST(OperatorsTest, CombineConcurrently)
+{
+  const int iterations = 10000;
+
+  std::atomic<int> combined(0);
+  std::atomic<int> inconsistent(0);
+
+  std::mutex lastSeenMutex;
+  std::tuple<int, int, std::string, std::string> lastSeen;
+
+  // One writer updates the first two inputs with the same counter, always in
+  // that order, so any snapshot taken at a single point in time must see
+  // either equal counters or the first one just ahead. The other writers use
+  // strings of identical characters, so a torn value would show up as a mix.
+  CombineOperator<void, int, int, std::string, std::string> sink([&](int a, int b, std::string c, std::string d) {
+    if (a != b && a != b + 1) {
+      inconsistent++;
+    }
+
+    for (const std::string *value : { &c, &d }) {
+      if (value->find_first_not_of(value->front()) != std::string::npos) {
+        inconsistent++;
+      }
+    }
+
+    std::lock_guard<std::mutex> guard(lastSeenMutex);
+    lastSeen = std::make_tuple(a, b, c, d);
+    combined++;
+  });
+
+  auto sinks = sink.sinks();
+  auto &first = std::get<0>(sinks);
+  auto &second = std::get<1>(sinks);
+
+  std::vector<std::function<bool(std::string)>> stringInputs = {
+    std::get<2>(sinks),
+    std::get<3>(sinks),
+  };
+
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    for (int j = 0; j < iterations; j++) {
+      first(j);
+      second(j);
+    }
+  });
+
+  for (size_t i = 0; i < stringInputs.size(); i++) {
+    threads.emplace_back([&stringInputs, i] {
+      for (int j = 0; j < iterations; j++) {
+        stringInputs[i](std::string(size_t(j % 32 + 1), char('c' + i)));
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_GT(combined.load(), 0);
+  EXPECT_EQ(inconsistent.load(), 0);
+
+  // Every input's latest value should be visible afterward.
+  EXPECT_TRUE(first(iterations));
+  EXPECT_EQ(lastSeen, std::make_tuple(iterations, iterations - 1, std::string(16, 'c'), std::string(16, 'd')));
+}
+
 TEST(OperatorsTest, ScheduleOn)
 {
-  auto schedulingSink = scheduleOn(ImmediateScheduler()).compose([](int value) {
+  auto schedulingSink = scheduleOn<FutureResult>(ImmediateScheduler()).compose([](int value) {
+    return value + 1;
+  });
+
+  EXPECT_EQ(schedulingSink(0).get(), 1);
+  EXPECT_EQ(schedulingSink(1).get(), 2);
+  EXPECT_EQ(schedulingSink(4).get(), 5);
+}
+
+TEST(OperatorsTest, ScheduleOnDiscardingResult)
+{
+  int sum = 0;
+
+  auto schedulingSink = scheduleOn(ImmediateScheduler()).compose([&sum](int value) {
+    sum += value;
+    return sum;
+  });
+
+  static_assert(std::is_void<decltype(schedulingSink(0))>::value, "scheduleOn() should discard results by default");
+
+  schedulingSink(1);
+  schedulingSink(2);
+  EXPECT_EQ(sum, 3);
+}
+
+namespace {
+
+/// Counts how many times it (or any copy of it) is copied.
+struct CopyCounter final
+{
+  public:
+    explicit CopyCounter (std::atomic<int> *copies) noexcept
+      : _copies(copies)
+    {}
+
+    CopyCounter (const CopyCounter &other) noexcept
+      : _copies(other._copies)
+    {
+      ++*_copies;
+    }
+
+    CopyCounter &operator= (const CopyCounter &other) noexcept
+    {
+      _copies = other._copies;
+      ++*_copies;
+      return *this;
+    }
+
+    CopyCounter (CopyCounter &&) = default;
+    CopyCounter &operator= (CopyCounter &&) = default;
+
+  private:
+    std::atomic<int> *_copies;
+};
+
+}
+
+TEST(OperatorsTest, ScheduleOnMovesInputs)
+{
+  std::atomic<int> copies(0);
+
+  {
+    auto sink = scheduleOn(ImmediateScheduler()).compose([](CopyCounter counter) {});
+
+    sink(CopyCounter(&copies));
+    EXPECT_EQ(copies, 0);
+  }
+
+  {
+    auto promise = std::make_shared<std::promise<void>>();
+
+    auto sink = sinkline(
+      scheduleOn(ThreadScheduler()),
+      scheduleOn(ThreadPoolScheduler(2)),
+      [promise](CopyCounter counter) {
+        promise->set_value();
+      });
+
+    sink(CopyCounter(&copies));
+
+    ASSERT_EQ(promise->get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(copies, 0);
+  }
+
+  {
+    auto sink = scheduleOn<FutureResult>(ThreadScheduler()).compose([](CopyCounter counter) {
+      return counter;
+    });
+
+    auto future = sink(CopyCounter(&copies));
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+
+    future.get();
+    EXPECT_EQ(copies, 0);
+  }
+}
+
+TEST(OperatorsTest, SharedCombine)
+{
+  std::atomic<int> copies(0);
+
+  {
+    SharedCombineOperator<int, CopyCounter, std::vector<int>> sizeSink([](const CopyCounter &counter, const std::vector<int> &values) {
+      return int(values.size());
+    });
+
+    auto sinks = sizeSink.sinks();
+
+    EXPECT_FALSE(bool(std::get<0>(sinks)(CopyCounter(&copies))));
+    EXPECT_EQ(std::get<1>(sinks)(std::vector<int>(3)).value(), 3);
+    EXPECT_EQ(std::get<1>(sinks)(std::vector<int>(5)).value(), 5);
+    EXPECT_EQ(std::get<0>(sinks)(CopyCounter(&copies)).value(), 5);
+  }
+
+  {
+    auto sinks = combineShared<CopyCounter, std::vector<int>>([](const CopyCounter &counter, const std::vector<int> &values) {
+      return int(values.size());
+    });
+
+    EXPECT_FALSE(bool(std::get<1>(sinks)(std::vector<int>(2))));
+    EXPECT_EQ(std::get<0>(sinks)(CopyCounter(&copies)).value(), 2);
+  }
+
+  EXPECT_EQ(copies, 0);
+}
+
+TEST(OperatorsTest, ScheduleOnThreadPool)
+{
+  auto schedulingSink = scheduleOn<FutureResult>(ThreadPoolScheduler(2)).compose([](int value) {
     return value + 1;
   });
 
@@ -121,6 +524,324 @@ TEST(OperatorsTest, ScheduleOn)
   EXPECT_EQ(schedulingSink(4).get(), 5);
 }
 
+TEST(OperatorsTest, ScheduleOnWithPriority)
+{
+  auto scheduler = std::make_shared<ThreadScheduler>();
+  scheduler->suspend();
+
+  // Only touched on the scheduler thread.
+  std::vector<int> order;
+
+  auto bulkSink = scheduleOn(scheduler, SchedulingPriority::Low).compose([&order](int value) {
+    order.push_back(value);
+  });
+
+  auto controlSink = scheduleOn<FutureResult>(scheduler, SchedulingPriority::High).compose([&order](int value) {
+    order.push_back(value);
+  });
+
+  bulkSink(1);
+  bulkSink(2);
+  auto controlled = controlSink(0);
+
+  scheduler->resume();
+
+  auto done = scheduler->schedule(SchedulingPriority::Low, [&order] {
+    return order;
+  });
+
+  ASSERT_EQ(done.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(done.get(), std::vector<int>({0, 1, 2}));
+}
+
+TEST(OperatorsTest, ScheduleOnInlineWhenCurrent)
+{
+  auto scheduler = std::make_shared<ThreadScheduler>();
+
+  // Only touched on the scheduler thread.
+  std::vector<int> order;
+
+  auto sink = scheduleOn<InlineWhenCurrent>(scheduler).compose([&order](int value) {
+    order.push_back(value);
+  });
+
+  scheduler->schedule([&] {
+    sink(1);
+    order.push_back(2);
+  }).wait();
+
+  sink(3);
+  EXPECT_EQ(scheduler->schedule([&order] { return order; }).get(), std::vector<int>({1, 2, 3}));
+}
+
+TEST(OperatorsTest, ScheduleLatestOn)
+{
+  auto scheduler = std::make_shared<ThreadScheduler>();
+
+  // Only touched on the scheduler thread.
+  std::vector<int> received;
+
+  auto sink = scheduleLatestOn(scheduler).compose([&received](int value, std::unique_ptr<int> extra) {
+    received.push_back(value + *extra);
+  });
+
+  scheduler->suspend();
+
+  for (int i = 0; i < 100; i++) {
+    sink(i, std::make_unique<int>(1000));
+  }
+
+  EXPECT_EQ(scheduler->statistics().queued, 1u);
+
+  scheduler->resume();
+  EXPECT_EQ(scheduler->schedule([&received] { return received; }).get(), std::vector<int>({1099}));
+
+  sink(5, std::make_unique<int>(0));
+  EXPECT_EQ(scheduler->schedule([&received] { return received; }).get(), std::vector<int>({1099, 5}));
+}
+
+TEST(OperatorsTest, ScheduleLatestOnRecoversFromOverflow)
+{
+  for (auto policy : { ThreadScheduler::OverflowPolicy::DropNewest, ThreadScheduler::OverflowPolicy::Reject }) {
+    ThreadScheduler::Options options;
+    options.capacity = 1;
+    options.overflowPolicy = policy;
+
+    auto scheduler = std::make_shared<ThreadScheduler>(options);
+    std::atomic<int> latest(0);
+
+    auto sink = scheduleLatestOn(scheduler).compose([&latest](int value) {
+      latest = value;
+    });
+
+    // Fill the queue, so that the sink's drain can't be posted.
+    scheduler->suspend();
+    scheduler->post([] {});
+
+    if (policy == ThreadScheduler::OverflowPolicy::Reject) {
+      EXPECT_THROW(sink(1), std::overflow_error);
+    } else {
+      sink(1);
+    }
+
+    scheduler->resume();
+
+    // Once there's room again, new inputs should still get through.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (latest != 2 && std::chrono::steady_clock::now() < deadline) {
+      try {
+        sink(2);
+      } catch (const std::overflow_error &) {
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(latest, 2);
+  }
+}
+
+namespace {
+
+/// Queues actions for the test to run by hand, and can reject the next post()
+/// after running a callback in the middle of it, to simulate another producer
+/// racing with the rejection.
+struct InterleavingScheduler final
+{
+  public:
+    std::vector<Task> _queue;
+    std::function<void()> _duringReject;
+
+    template<typename Action>
+    void post (Action &&action)
+    {
+      Task task(std::forward<Action>(action));
+
+      if (_duringReject) {
+        task.reset();
+
+        auto duringReject = std::move(_duringReject);
+        _duringReject = nullptr;
+        duringReject();
+
+        throw std::overflow_error("Rejected");
+      }
+
+      _queue.push_back(std::move(task));
+    }
+};
+
+}
+
+TEST(OperatorsTest, ScheduleLatestOnRejectingWhileRacing)
+{
+  auto scheduler = std::make_shared<InterleavingScheduler>();
+  std::vector<int> forwarded;
+
+  auto sink = scheduleLatestOn(scheduler).compose([&forwarded](int value) {
+    forwarded.push_back(value);
+  });
+
+  // Once the first drain is rejected, another input gets its own drain
+  // queued before the rejection reaches the first input.
+  scheduler->_duringReject = [&sink] {
+    sink(2);
+  };
+
+  EXPECT_THROW(sink(1), std::overflow_error);
+  ASSERT_EQ(scheduler->_queue.size(), 1u);
+
+  // That drain is still queued, so this shouldn't queue another.
+  sink(3);
+  ASSERT_EQ(scheduler->_queue.size(), 1u);
+
+  auto queue = std::move(scheduler->_queue);
+  for (auto &task : queue) {
+    task();
+  }
+
+  EXPECT_EQ(forwarded, (std::vector<int>{ 3 }));
+}
+
+TEST(OperatorsTest, ScheduleLatestOnRejectingConcurrently)
+{
+  ThreadScheduler::Options options;
+  options.capacity = 2;
+  options.overflowPolicy = ThreadScheduler::OverflowPolicy::Reject;
+
+  auto scheduler = std::make_shared<ThreadScheduler>(options);
+  std::atomic<int> latest(0);
+
+  auto sink = scheduleLatestOn(scheduler).compose([&latest](int value) {
+    latest = value;
+  });
+
+  // Keep the queue close to full, so that drains are rejected while other
+  // producers are racing to post their own.
+  std::atomic<bool> done(false);
+  std::thread filler([&] {
+    while (!done) {
+      try {
+        scheduler->post([] {});
+      } catch (const std::overflow_error &) {
+      }
+    }
+  });
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; i++) {
+    producers.emplace_back([&sink] {
+      for (int j = 1; j <= 10000; j++) {
+        try {
+          sink(j);
+        } catch (const std::overflow_error &) {
+        }
+      }
+    });
+  }
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  done = true;
+  filler.join();
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (latest != -1 && std::chrono::steady_clock::now() < deadline) {
+    try {
+      sink(-1);
+    } catch (const std::overflow_error &) {
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(latest, -1);
+}
+
+TEST(OperatorsTest, Buffer)
+{
+  auto scheduler = std::make_shared<VirtualTimeScheduler>();
+  std::vector<std::vector<int>> batches;
+
+  auto bufferSink = buffer<int>(3, std::chrono::seconds(10), scheduler).compose([&batches](const std::vector<int> &batch) {
+    batches.push_back(batch);
+  });
+
+  // A full batch should be forwarded immediately.
+  bufferSink(1);
+  bufferSink(2);
+  EXPECT_TRUE(batches.empty());
+
+  bufferSink(3);
+  EXPECT_EQ(batches, (std::vector<std::vector<int>>{ { 1, 2, 3 } }));
+
+  // A partial batch should be forwarded once its timer fires.
+  bufferSink(4);
+  scheduler->advanceBy(std::chrono::seconds(5));
+  EXPECT_EQ(batches.size(), 1u);
+
+  scheduler->advanceBy(std::chrono::seconds(5));
+  EXPECT_EQ(batches, (std::vector<std::vector<int>>{ { 1, 2, 3 }, { 4 } }));
+
+  // The timer for a batch which filled up shouldn't cut the next one short.
+  bufferSink(5);
+  bufferSink(6);
+  bufferSink(7);
+  scheduler->advanceBy(std::chrono::seconds(5));
+
+  bufferSink(8);
+  scheduler->advanceBy(std::chrono::seconds(5));
+  EXPECT_EQ(batches.size(), 3u);
+
+  scheduler->advanceBy(std::chrono::seconds(5));
+  EXPECT_EQ(batches, (std::vector<std::vector<int>>{ { 1, 2, 3 }, { 4 }, { 5, 6, 7 }, { 8 } }));
+}
+
+TEST(OperatorsTest, BufferConcurrently)
+{
+  const int threadCount = 4;
+  const int iterations = 1000;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t received = 0;
+  size_t oversized = 0;
+
+  auto bufferSink = buffer<int>(64, std::chrono::milliseconds(10), ThreadScheduler()).compose([&](const std::vector<int> &batch) {
+    std::lock_guard<std::mutex> guard(mutex);
+
+    received += batch.size();
+    if (batch.size() > 64) {
+      oversized++;
+    }
+
+    condition.notify_all();
+  });
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back([&bufferSink] {
+      for (int j = 0; j < iterations; j++) {
+        bufferSink(j);
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // The last partial batch is forwarded by its timer.
+  std::unique_lock<std::mutex> lock(mutex);
+  EXPECT_TRUE(condition.wait_for(lock, std::chrono::seconds(1), [&] {
+    return received == threadCount * iterations;
+  }));
+
+  EXPECT_EQ(oversized, 0u);
+}
+
 TEST(OperatorsTest, SideEffect)
 {
   int sum = 0;
@@ -188,6 +909,30 @@ TEST(OperatorsTest, RecoverSink)
   EXPECT_EQ(errors, 1);
 }
 
+TEST(OperatorsTest, OnErrorMovesInputs)
+{
+  std::atomic<int> copies(0);
+  int successes = 0;
+
+  auto errorSink = onError([](const char *error) {}).compose([&successes](CopyCounter counter) {
+    successes++;
+  });
+
+  errorSink(static_cast<const char *>(nullptr), CopyCounter(&copies));
+
+  auto recoverSink = recover([&copies](const char *error) {
+    return CopyCounter(&copies);
+  }).compose([&successes](CopyCounter counter) {
+    successes++;
+  });
+
+  recoverSink(CopyCounter(&copies), static_cast<const char *>(nullptr));
+  recoverSink(CopyCounter(&copies), "foobar");
+
+  EXPECT_EQ(successes, 3);
+  EXPECT_EQ(copies, 0);
+}
+
 TEST(OperatorsTest, Then)
 {
   auto addSink = [](int a, int b) {
@@ -9,10 +9,25 @@
 
 #include "TestCommon.h"
 
+#include <sinkline/EventLoopScheduler.h>
 #include <sinkline/Scheduler.h>
+#include <sinkline/StrandScheduler.h>
+#include <sinkline/ThreadPoolScheduler.h>
+#include <sinkline/VirtualTimeScheduler.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <unistd.h>
 
 using namespace fb::sinkline;
 
@@ -30,6 +45,959 @@ TEST(SchedulerTest, ThreadScheduler)
   EXPECT_EQ(result, std::future_status::ready);
 }
 
+TEST(SchedulerTest, ThreadSchedulerPost)
+{
+  ThreadScheduler s;
+
+  auto promise = std::make_shared<std::promise<void>>();
+
+  s.post([=] {
+    throw std::runtime_error("should be discarded");
+  });
+
+  s.post([=] {
+    promise->set_value();
+  });
+
+  auto result = promise->get_future().wait_for(std::chrono::seconds(1));
+  EXPECT_EQ(result, std::future_status::ready);
+}
+
+TEST(SchedulerTest, ThreadSchedulerMoveOnlyAction)
+{
+  ThreadScheduler s;
+
+  auto value = std::make_unique<int>(5);
+  auto future = s.schedule([value = std::move(value)] {
+    return *value * 2;
+  });
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 10);
+}
+
+TEST(SchedulerTest, ThreadSchedulerMoveOnlyArgument)
+{
+  ThreadScheduler s;
+
+  auto future = s.schedule([](std::unique_ptr<int> value) {
+    return *value * 2;
+  }, std::make_unique<int>(5));
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 10);
+}
+
+TEST(SchedulerTest, ImmediateSchedulerPassesReferences)
+{
+  ImmediateScheduler s;
+  int value = 5;
+
+  auto future = s.schedule([](int &v) {
+    return ++v;
+  }, value);
+
+  EXPECT_EQ(future.get(), 6);
+  EXPECT_EQ(value, 6);
+}
+
+TEST(SchedulerTest, Reschedule)
+{
+  ImmediateScheduler s;
+  auto scheduler = &s;
+
+  int received = 0;
+  auto rescheduled = reschedule(scheduler, [&received](int value) {
+    received = value;
+  });
+
+  rescheduled(5);
+  EXPECT_EQ(received, 5);
+}
+
+namespace {
+
+// Recurses through the scheduler, recording the range of stack addresses
+// used.
+void recurseOn (TrampolineScheduler &scheduler, int remaining, uintptr_t &lowest, uintptr_t &highest)
+{
+  int local = 0;
+  auto address = reinterpret_cast<uintptr_t>(&local);
+
+  lowest = std::min(lowest, address);
+  highest = std::max(highest, address);
+
+  if (remaining > 0) {
+    scheduler.post([&, remaining] {
+      recurseOn(scheduler, remaining - 1, lowest, highest);
+    });
+  }
+}
+
+}
+
+TEST(SchedulerTest, TrampolineScheduler)
+{
+  TrampolineScheduler s;
+
+  std::vector<int> order;
+
+  s.post([&] {
+    EXPECT_TRUE(TrampolineScheduler::isTrampolining());
+
+    s.post([&] {
+      order.push_back(2);
+    });
+
+    order.push_back(1);
+  });
+
+  EXPECT_FALSE(TrampolineScheduler::isTrampolining());
+  EXPECT_EQ(order, std::vector<int>({1, 2}));
+  EXPECT_EQ(s.schedule([] { return 5; }).get(), 5);
+
+  uintptr_t lowest = UINTPTR_MAX;
+  uintptr_t highest = 0;
+  recurseOn(s, 100000, lowest, highest);
+
+  // Without trampolining, this would need megabytes of stack.
+  EXPECT_LT(highest - lowest, 64u * 1024u);
+}
+
+TEST(SchedulerTest, ThreadSchedulerManyProducers)
+{
+  ThreadScheduler s;
+
+  static constexpr int producerCount = 4;
+  static constexpr int actionCount = 1000;
+
+  // Only touched on the scheduler thread.
+  std::vector<int> lastSeen(producerCount, -1);
+  bool ordered = true;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producerCount; p++) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < actionCount; i++) {
+        s.schedule([&, p, i] {
+          ordered = ordered && lastSeen[p] == i - 1;
+          lastSeen[p] = i;
+        });
+      }
+    });
+  }
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  auto done = s.schedule([] {});
+  ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+  EXPECT_TRUE(ordered);
+  for (int p = 0; p < producerCount; p++) {
+    EXPECT_EQ(lastSeen[p], actionCount - 1);
+  }
+}
+
+TEST(SchedulerTest, ThreadSchedulerSuspendResume)
+{
+  ThreadScheduler s;
+  s.suspend();
+
+  auto future = s.schedule([] {});
+  EXPECT_EQ(future.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+
+  s.resume();
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+}
+
+TEST(SchedulerTest, ThreadSchedulerNotifiesOnlyWhenEmpty)
+{
+  ThreadScheduler s;
+
+  s.suspend();
+
+  for (int i = 0; i < 100; i++) {
+    s.post([] {});
+  }
+
+  s.resume();
+  s.schedule([] {}).wait();
+
+  // At most the first action should have needed to wake up the thread.
+  auto statistics = s.statistics();
+  EXPECT_EQ(statistics.notifications + statistics.notificationsAvoided, 101u);
+  EXPECT_LE(statistics.notifications, 2u);
+}
+
+TEST(SchedulerTest, ThreadSchedulerSpinThenPark)
+{
+  ThreadScheduler::Options options;
+  options.spinDuration = std::chrono::seconds(1);
+
+  ThreadScheduler s(options);
+
+  s.schedule([] {}).wait();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  auto before = s.statistics();
+
+  // The scheduler thread should still be spinning, so this shouldn't need to
+  // notify it.
+  s.schedule([] {}).wait();
+  auto after = s.statistics();
+
+  EXPECT_EQ(after.notifications, before.notifications);
+  EXPECT_GE(after.spinWakeups, 1u);
+}
+
+TEST(SchedulerTest, ThreadSchedulerPriorities)
+{
+  ThreadScheduler s;
+
+  // Only touched on the scheduler thread.
+  std::vector<int> order;
+
+  s.suspend();
+
+  s.post(SchedulingPriority::Low, [&order] { order.push_back(3); });
+  s.post([&order] { order.push_back(2); });
+  s.post(SchedulingPriority::High, [&order] { order.push_back(0); });
+  s.post(SchedulingPriority::High, [&order] { order.push_back(1); });
+  s.post(SchedulingPriority::Low, [&order] { order.push_back(4); });
+
+  s.resume();
+
+  auto result = s.schedule(SchedulingPriority::Low, [&order] {
+    return order;
+  });
+
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(result.get(), std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(SchedulerTest, ThreadSchedulerStarvationLimit)
+{
+  ThreadScheduler::Options options;
+  options.starvationLimit = 2;
+
+  ThreadScheduler s(options);
+
+  // Only touched on the scheduler thread.
+  std::vector<int> order;
+
+  s.suspend();
+
+  s.post(SchedulingPriority::Low, [&order] { order.push_back(-1); });
+
+  for (int i = 0; i < 5; i++) {
+    s.post(SchedulingPriority::High, [&order, i] { order.push_back(i); });
+  }
+
+  s.resume();
+
+  auto result = s.schedule(SchedulingPriority::High, [&order] {
+    return order;
+  });
+
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(result.get(), std::vector<int>({0, 1, -1, 2, 3, 4}));
+}
+
+namespace {
+
+// Waits for everything queued on the scheduler to run.
+void waitUntilDrained (const ThreadScheduler &s)
+{
+  for (int i = 0; i < 1000 && s.statistics().queued > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  ASSERT_EQ(s.statistics().queued, 0u);
+}
+
+}
+
+TEST(SchedulerTest, ThreadSchedulerDropNewest)
+{
+  ThreadScheduler::Options options;
+  options.capacity = 4;
+  options.overflowPolicy = ThreadScheduler::OverflowPolicy::DropNewest;
+
+  ThreadScheduler s(options);
+  std::atomic<int> count(0);
+
+  s.suspend();
+
+  for (int i = 0; i < 10; i++) {
+    s.post([&count] { count++; });
+  }
+
+  auto dropped = s.schedule([] {});
+
+  s.resume();
+  waitUntilDrained(s);
+
+  EXPECT_EQ(count, 4);
+  EXPECT_THROW(dropped.get(), std::future_error);
+
+  auto statistics = s.statistics();
+  EXPECT_EQ(statistics.dropped, 7u);
+  EXPECT_EQ(statistics.highWaterMark, 4u);
+}
+
+TEST(SchedulerTest, ThreadSchedulerDropOldest)
+{
+  ThreadScheduler::Options options;
+  options.capacity = 2;
+  options.overflowPolicy = ThreadScheduler::OverflowPolicy::DropOldest;
+
+  ThreadScheduler s(options);
+
+  std::mutex mutex;
+  std::vector<int> values;
+
+  s.suspend();
+
+  for (int i = 0; i < 4; i++) {
+    s.post([&, i] {
+      std::lock_guard<std::mutex> guard(mutex);
+      values.push_back(i);
+    });
+  }
+
+  s.resume();
+  waitUntilDrained(s);
+
+  std::lock_guard<std::mutex> guard(mutex);
+  EXPECT_EQ(values, std::vector<int>({2, 3}));
+  EXPECT_EQ(s.statistics().dropped, 2u);
+}
+
+TEST(SchedulerTest, ThreadSchedulerReject)
+{
+  ThreadScheduler::Options options;
+  options.capacity = 2;
+  options.overflowPolicy = ThreadScheduler::OverflowPolicy::Reject;
+
+  ThreadScheduler s(options);
+
+  s.suspend();
+  s.post([] {});
+  s.post([] {});
+
+  EXPECT_THROW(s.post([] {}), std::overflow_error);
+  EXPECT_EQ(s.statistics().rejected, 1u);
+
+  s.resume();
+}
+
+TEST(SchedulerTest, ThreadSchedulerBlock)
+{
+  ThreadScheduler::Options options;
+  options.capacity = 1;
+
+  ThreadScheduler s(options);
+  std::atomic<int> count(0);
+
+  s.suspend();
+  s.post([&count] { count++; });
+
+  std::thread producer([&] {
+    s.post([&count] { count++; });
+  });
+
+  for (int i = 0; i < 1000 && s.statistics().blocked == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(s.statistics().blocked, 1u);
+  EXPECT_EQ(count, 0);
+
+  s.resume();
+  producer.join();
+  waitUntilDrained(s);
+
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(s.statistics().highWaterMark, 1u);
+}
+
+namespace {
+
+// Checks that dispatch() runs inline only while nothing is queued, from within
+// an action on the given scheduler.
+template<typename Scheduler>
+void testDispatch (Scheduler &s)
+{
+  EXPECT_FALSE(s.isCurrent());
+
+  // Only touched on the scheduler.
+  std::vector<int> order;
+
+  s.schedule([&] {
+    EXPECT_TRUE(s.isCurrent());
+
+    s.dispatch([&] { order.push_back(1); });
+    order.push_back(2);
+
+    s.post([&] { order.push_back(4); });
+    s.dispatch([&] { order.push_back(5); });
+    order.push_back(3);
+  }).wait();
+
+  EXPECT_EQ(s.schedule([&] { return order; }).get(), std::vector<int>({1, 2, 3, 4, 5}));
+}
+
+}
+
+TEST(SchedulerTest, ThreadSchedulerDispatch)
+{
+  ThreadScheduler s;
+  testDispatch(s);
+}
+
+TEST(SchedulerTest, StrandSchedulerDispatch)
+{
+  StrandScheduler<> s(std::make_shared<ThreadPoolScheduler>(2));
+  testDispatch(s);
+}
+
+TEST(SchedulerTest, ThreadPoolSchedulerIsCurrent)
+{
+  ThreadPoolScheduler s(2);
+
+  EXPECT_FALSE(s.isCurrent());
+  EXPECT_TRUE(s.schedule([&s] { return s.isCurrent(); }).get());
+}
+
+TEST(SchedulerTest, ThreadSchedulerScheduleAfter)
+{
+  ThreadScheduler s;
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Only touched on the scheduler thread.
+  std::vector<int> order;
+
+  s.scheduleAfter(start + std::chrono::milliseconds(30), [&order] {
+    order.push_back(3);
+  });
+
+  s.scheduleAfter(start + std::chrono::milliseconds(10), [&order] {
+    order.push_back(1);
+  });
+
+  // Time points from other clocks should be converted.
+  s.scheduleAfter(std::chrono::system_clock::now() + std::chrono::milliseconds(20), [&order] {
+    order.push_back(2);
+  });
+
+  s.post([&order] {
+    order.push_back(0);
+  });
+
+  auto last = s.scheduleAfter(start + std::chrono::milliseconds(40), [start] {
+    return std::chrono::steady_clock::now() - start;
+  });
+
+  ASSERT_EQ(last.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_GE(last.get(), std::chrono::milliseconds(40));
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3}));
+}
+
+TEST(SchedulerTest, ThreadSchedulerManyTimers)
+{
+  ThreadScheduler s;
+
+  static constexpr int timerCount = 100000;
+  auto start = std::chrono::steady_clock::now();
+
+  // Only touched on the scheduler thread.
+  int fired = 0;
+  bool ordered = true;
+  auto lastDeadline = start;
+
+  // Keep any timers from firing until they've all been added, so that their
+  // order can be verified.
+  s.suspend();
+
+  for (int i = 0; i < timerCount; i++) {
+    // Scatter the deadlines, so they aren't inserted in order.
+    auto deadline = start + std::chrono::microseconds((i * 7919) % 50000);
+
+    s.scheduleAfter(deadline, [&, deadline] {
+      ordered = ordered && lastDeadline <= deadline && std::chrono::steady_clock::now() >= deadline;
+      lastDeadline = deadline;
+      fired++;
+    });
+  }
+
+  auto done = s.scheduleAfter(start + std::chrono::milliseconds(50), [] {});
+  s.resume();
+
+  ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(fired, timerCount);
+}
+
+TEST(SchedulerTest, ThreadPoolScheduler)
+{
+  ThreadPoolScheduler s(4);
+  EXPECT_EQ(s.threadCount(), 4u);
+
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 100; i++) {
+    futures.push_back(s.schedule([](int x) {
+      return x * 2;
+    }, i));
+  }
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(futures[i].wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(futures[i].get(), i * 2);
+  }
+}
+
+TEST(SchedulerTest, ThreadPoolSchedulerWorkStealing)
+{
+  auto s = std::make_shared<ThreadPoolScheduler>(2);
+
+  // Actions scheduled from within the pool land on the scheduling worker's own
+  // deque. Since that worker is blocked until they finish, they can only run
+  // if the other worker steals them.
+  auto outer = s->schedule([s] {
+    std::atomic<int> completed(0);
+
+    std::vector<std::future<void>> inner;
+    for (int i = 0; i < 10; i++) {
+      inner.push_back(s->schedule([&completed] {
+        ++completed;
+      }));
+    }
+
+    for (auto &future : inner) {
+      future.wait();
+    }
+
+    return completed.load();
+  });
+
+  ASSERT_EQ(outer.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(outer.get(), 10);
+}
+
+TEST(SchedulerTest, ThreadPoolSchedulerScheduleAfter)
+{
+  ThreadPoolScheduler s(2);
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::future<std::chrono::steady_clock::duration>> futures;
+  for (int i = 5; i > 0; i--) {
+    futures.push_back(s.scheduleAfter(start + std::chrono::milliseconds(i * 10), [start] {
+      return std::chrono::steady_clock::now() - start;
+    }));
+  }
+
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(futures[i].wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_GE(futures[i].get(), std::chrono::milliseconds((5 - i) * 10));
+  }
+}
+
+TEST(SchedulerTest, StrandScheduler)
+{
+  auto pool = std::make_shared<ThreadPoolScheduler>(4);
+
+  constexpr int strandCount = 8;
+  constexpr int actionCount = 1000;
+
+  std::vector<std::unique_ptr<StrandScheduler<>>> strands;
+  std::vector<std::vector<int>> values(strandCount);
+  std::vector<std::unique_ptr<std::atomic<bool>>> running;
+
+  for (int i = 0; i < strandCount; i++) {
+    strands.push_back(std::make_unique<StrandScheduler<>>(pool));
+    running.push_back(std::make_unique<std::atomic<bool>>(false));
+  }
+
+  std::atomic<int> overlaps(0);
+
+  for (int i = 0; i < actionCount; i++) {
+    for (int j = 0; j < strandCount; j++) {
+      strands[j]->post([&, i, j] {
+        if (running[j]->exchange(true)) {
+          overlaps++;
+        }
+
+        values[j].push_back(i);
+        running[j]->store(false);
+      });
+    }
+  }
+
+  std::vector<int> expected;
+  for (int i = 0; i < actionCount; i++) {
+    expected.push_back(i);
+  }
+
+  for (int j = 0; j < strandCount; j++) {
+    auto future = strands[j]->schedule([&values, j] {
+      return values[j];
+    });
+
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(future.get(), expected);
+  }
+
+  EXPECT_EQ(overlaps, 0);
+}
+
+TEST(SchedulerTest, StrandSchedulerScheduleAfter)
+{
+  StrandScheduler<ThreadScheduler> strand(std::make_shared<ThreadScheduler>());
+
+  auto start = std::chrono::steady_clock::now();
+  auto future = strand.scheduleAfter(start + std::chrono::milliseconds(20), [start] {
+    return std::chrono::steady_clock::now() - start;
+  });
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_GE(future.get(), std::chrono::milliseconds(20));
+}
+
+TEST(SchedulerTest, StrandSchedulerRecoversFromOverflow)
+{
+  for (auto policy : { ThreadScheduler::OverflowPolicy::DropNewest, ThreadScheduler::OverflowPolicy::Reject }) {
+    ThreadScheduler::Options options;
+    options.capacity = 1;
+    options.overflowPolicy = policy;
+
+    auto target = std::make_shared<ThreadScheduler>(options);
+    StrandScheduler<ThreadScheduler> strand(target);
+    std::atomic<int> count(0);
+
+    // Fill the target's queue, so that the strand's drain can't be posted.
+    target->suspend();
+    target->post([] {});
+
+    if (policy == ThreadScheduler::OverflowPolicy::Reject) {
+      EXPECT_THROW(strand.post([&count] { count++; }), std::overflow_error);
+    } else {
+      strand.post([&count] { count++; });
+    }
+
+    target->resume();
+    waitUntilDrained(*target);
+
+    // Once there's room again, the strand should run the action that was
+    // left queued, along with new ones.
+    auto future = strand.schedule([] {});
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(count, 1);
+  }
+}
+
+#ifdef CPU_SET
+
+namespace {
+
+/// The CPUs which this process is allowed to run upon, which may be a subset
+/// of the machine's (e.g., within a cpuset-restricted container).
+std::vector<unsigned> allowedCPUs ()
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  std::vector<unsigned> cpus;
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return cpus;
+  }
+
+  for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return cpus;
+}
+
+}
+
+TEST(SchedulerTest, ThreadSchedulerPlacement)
+{
+  auto cpus = allowedCPUs();
+  if (cpus.empty()) {
+    GTEST_SKIP() << "Could not determine this process's CPU affinity";
+  }
+
+  // Pick the last allowed CPU, so this doesn't just match the default.
+  unsigned cpu = cpus.back();
+
+  ThreadScheduler::Options options;
+  options.placement = ThreadPlacement({cpu});
+
+  ThreadScheduler s(options);
+
+  EXPECT_EQ(s.schedule(&sched_getcpu).get(), static_cast<int>(cpu));
+}
+
+TEST(SchedulerTest, ThreadSchedulerInvalidPlacement)
+{
+  ThreadScheduler::Options options;
+  options.placement = ThreadPlacement({CPU_SETSIZE - 1});
+
+  EXPECT_THROW(ThreadScheduler s(options), std::system_error);
+}
+
+TEST(SchedulerTest, ThreadPoolSchedulerNUMAPlacement)
+{
+  ThreadPlacement placement;
+
+  try {
+    placement = ThreadPlacement::numaNode(0);
+  } catch (const std::system_error &) {
+    GTEST_SKIP() << "NUMA topology is unavailable";
+  }
+
+  ASSERT_FALSE(placement.isUnrestricted());
+
+  // The node's CPUs may all be outside this process's affinity.
+  auto allowed = allowedCPUs();
+  bool anyAllowed = std::any_of(placement.cpus().begin(), placement.cpus().end(), [&allowed](unsigned cpu) {
+    return std::find(allowed.begin(), allowed.end(), cpu) != allowed.end();
+  });
+
+  if (!anyAllowed) {
+    GTEST_SKIP() << "None of NUMA node 0's CPUs are available to this process";
+  }
+
+  ThreadPoolScheduler s(4, {placement});
+
+  std::vector<std::future<int>> cpus;
+  for (int i = 0; i < 16; i++) {
+    cpus.push_back(s.schedule(&sched_getcpu));
+  }
+
+  for (auto &cpu : cpus) {
+    auto it = std::find(placement.cpus().begin(), placement.cpus().end(), static_cast<unsigned>(cpu.get()));
+    EXPECT_NE(it, placement.cpus().end());
+  }
+}
+
+#endif
+
+TEST(SchedulerTest, VirtualTimeSchedulerOrdersByDeadline)
+{
+  VirtualTimeScheduler s;
+  std::vector<int> order;
+
+  auto start = s.now();
+
+  s.scheduleAfter(start + std::chrono::seconds(30), [&order] {
+    order.push_back(3);
+  });
+
+  s.scheduleAfter(start + std::chrono::seconds(10), [&order] {
+    order.push_back(1);
+  });
+
+  s.post([&order] {
+    order.push_back(0);
+  });
+
+  auto second = s.scheduleAfter(start + std::chrono::seconds(20), [&] {
+    order.push_back(2);
+    return s.now() - start;
+  });
+
+  // Nothing should run until the clock is advanced.
+  EXPECT_TRUE(order.empty());
+  EXPECT_EQ(s.pendingCount(), 4u);
+
+  EXPECT_EQ(s.advanceBy(std::chrono::seconds(25)), 3u);
+  EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2 }));
+  EXPECT_EQ(s.now(), start + std::chrono::seconds(25));
+
+  ASSERT_EQ(second.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+  EXPECT_EQ(second.get(), std::chrono::seconds(20));
+
+  EXPECT_EQ(s.runUntilIdle(), 1u);
+  EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2, 3 }));
+  EXPECT_EQ(s.now(), start + std::chrono::seconds(30));
+}
+
+TEST(SchedulerTest, VirtualTimeSchedulerRunsActionsScheduledWhileAdvancing)
+{
+  VirtualTimeScheduler s;
+  std::vector<int> order;
+
+  s.post([&] {
+    order.push_back(1);
+
+    // Time points in the past should run at the current time.
+    s.scheduleAfter(s.now() - std::chrono::seconds(5), [&order] {
+      order.push_back(2);
+    });
+
+    s.scheduleAfter(s.now() + std::chrono::seconds(1), [&order] {
+      order.push_back(3);
+    });
+  });
+
+  EXPECT_EQ(s.advanceBy(std::chrono::seconds(1)), 3u);
+  EXPECT_EQ(order, (std::vector<int>{ 1, 2, 3 }));
+  EXPECT_EQ(s.pendingCount(), 0u);
+}
+
+TEST(SchedulerTest, VirtualTimeSchedulerSimulatesLongPeriodsQuickly)
+{
+  VirtualTimeScheduler s;
+
+  const uint64_t ticks = 1000000;
+  uint64_t count = 0;
+
+  std::function<void()> tick = [&] {
+    if (++count < ticks) {
+      s.scheduleAfter(s.now() + std::chrono::seconds(1), tick);
+    }
+  };
+
+  s.post(tick);
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(s.runUntilIdle(), ticks);
+
+  EXPECT_EQ(count, ticks);
+  EXPECT_EQ(s.now().time_since_epoch(), std::chrono::seconds(ticks - 1));
+
+  // A million simulated seconds should take nowhere near that long.
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(30));
+}
+
+#ifdef EPOLLIN
+
+TEST(SchedulerTest, EventLoopScheduler)
+{
+  EventLoopScheduler s;
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Only touched on the event loop thread.
+  std::vector<int> order;
+
+  s.scheduleAfter(start + std::chrono::milliseconds(20), [&order] {
+    order.push_back(2);
+  });
+
+  s.scheduleAfter(start + std::chrono::milliseconds(10), [&order] {
+    order.push_back(1);
+  });
+
+  s.post([&order] {
+    order.push_back(0);
+  });
+
+  auto last = s.scheduleAfter(start + std::chrono::milliseconds(30), [start] {
+    return std::chrono::steady_clock::now() - start;
+  });
+
+  ASSERT_EQ(last.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_GE(last.get(), std::chrono::milliseconds(30));
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+
+  auto future = s.schedule([](int value) {
+    return value * 2;
+  }, 21);
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 42);
+}
+
+TEST(SchedulerTest, EventLoopSchedulerDispatch)
+{
+  EventLoopScheduler s;
+  testDispatch(s);
+}
+
+TEST(SchedulerTest, EventLoopSchedulerWatch)
+{
+  EventLoopScheduler s;
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  auto loopThread = s.schedule([] {
+    return std::this_thread::get_id();
+  }).get();
+
+  auto promise = std::make_shared<std::promise<std::thread::id>>();
+
+  s.watch(fds[0], EPOLLIN, [=, &s](int fd, uint32_t events) {
+    EXPECT_EQ(fd, fds[0]);
+    EXPECT_TRUE(events & EPOLLIN);
+
+    char byte;
+    EXPECT_EQ(read(fd, &byte, 1), 1);
+    EXPECT_EQ(byte, 'x');
+
+    s.unwatch(fd);
+    promise->set_value(std::this_thread::get_id());
+  });
+
+  EXPECT_THROW(s.watch(fds[0], EPOLLIN, [](int, uint32_t) {}), std::system_error);
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+
+  auto future = promise->get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), loopThread);
+
+  // Once unwatched, further writes should not invoke the sink again.
+  ASSERT_EQ(write(fds[1], "y", 1), 1);
+  s.schedule([] {}).wait();
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(SchedulerTest, EventLoopSchedulerWatchThrows)
+{
+  EventLoopScheduler s;
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  auto invoked = std::make_shared<std::promise<void>>();
+
+  s.watch(fds[0], EPOLLIN, [&s, invoked](int fd, uint32_t) {
+    char byte;
+    EXPECT_EQ(read(fd, &byte, 1), 1);
+
+    s.unwatch(fd);
+    invoked->set_value();
+    throw std::runtime_error("sink failed");
+  });
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  ASSERT_EQ(invoked->get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+
+  // The loop should survive the exception, and keep running actions.
+  auto future = s.schedule([] {
+    return 5;
+  });
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_EQ(future.get(), 5);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+#endif
+
 #if DISPATCH_API_VERSION
 
 TEST(SchedulerTest, GlobalGCDScheduler)
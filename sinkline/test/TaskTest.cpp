@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT-style license found in the
+ * LICENSE file in the root directory of this source tree. 
+
+ */
+
+#include "TestCommon.h"
+
+#include <sinkline/Task.h>
+
+#include <array>
+#include <memory>
+
+using namespace fb::sinkline;
+
+TEST(TaskTest, MoveOnlyCallable)
+{
+  int result = 0;
+  auto value = std::make_unique<int>(5);
+
+  Task task([&result, value = std::move(value)] {
+    result = *value;
+  });
+
+  Task moved(std::move(task));
+  EXPECT_FALSE(static_cast<bool>(task));
+  EXPECT_TRUE(static_cast<bool>(moved));
+
+  moved();
+  EXPECT_EQ(result, 5);
+}
+
+TEST(TaskTest, DestroysCallable)
+{
+  auto counter = std::make_shared<int>(0);
+
+  {
+    Task task([counter] {});
+    EXPECT_EQ(counter.use_count(), 2);
+
+    Task other;
+    other = std::move(task);
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(TaskTest, LargeCallable)
+{
+  std::array<char, Task::inline_size * 2> large;
+  large.fill(1);
+
+  int sum = 0;
+  Task task([&sum, large] {
+    for (char c : large) {
+      sum += c;
+    }
+  });
+
+  Task moved(std::move(task));
+  moved();
+  EXPECT_EQ(sum, static_cast<int>(large.size()));
+}
@@ -11,6 +11,8 @@
 
 #include <sinkline/TupleExt.h>
 
+#include <string>
+
 using namespace fb::sinkline;
 
 TEST(TupleExtTest, Extract)
@@ -32,6 +34,39 @@ TEST(TupleExtTest, Extract)
   }
 }
 
+TEST(TupleExtTest, ExtractReferences)
+{
+  int value = 0;
+  std::string str = "foobar";
+  bool flag = true;
+
+  // Arguments should be forwarded by reference, including lvalues of the
+  // extracted type.
+  int extracted = 5;
+  auto result = extract(&value, str, extracted, std::move(flag));
+
+  static_assert(std::is_same<decltype(result), std::tuple<std::string &, bool &&>>::value, "extract() should forward the remaining arguments");
+
+  EXPECT_EQ(value, 5);
+  EXPECT_EQ(&std::get<0>(result), &str);
+  EXPECT_EQ(&std::get<1>(result), &flag);
+
+  // A temporary tuple's remaining elements should be returned by value, so
+  // they don't dangle.
+  auto fromTemporary = extract(std::make_tuple(std::string("foo"), 6, false), &value);
+
+  static_assert(std::is_same<decltype(fromTemporary), std::tuple<std::string, bool>>::value, "extract() should return values from a temporary tuple");
+  EXPECT_EQ(value, 6);
+  EXPECT_EQ(std::get<0>(fromTemporary), "foo");
+
+  // Without a matching argument, nothing should be removed.
+  value = 0;
+  auto unchanged = extract(&value, str, flag);
+
+  EXPECT_EQ(std::tuple_size<decltype(unchanged)>::value, 2u);
+  EXPECT_EQ(value, 0);
+}
+
 TEST(TupleExtTest, FlattenOptionals)
 {
   {